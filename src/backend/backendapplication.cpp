@@ -97,6 +97,7 @@ QCoro::Task<int> BackendApplication::rebuildDatabase()
 
         blti.finalize();
         blti.exportDatabase();
+        blti.printTimings();
 
     } catch (const Exception &e) {
         QString error = e.errorString();
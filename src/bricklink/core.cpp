@@ -517,6 +517,25 @@ void Core::setUpdateIntervals(const QMap<QByteArray, int> &intervals)
 #endif
 }
 
+void Core::setCacheSizeLimits(const QMap<QByteArray, int> &limits)
+{
+#if !defined(BS_BACKEND)
+    m_pictureCache->setMaxDiskSize(qint64(limits["Picture"]) * 1'000'000);
+    m_priceGuideCache->setMaxDiskSize(qint64(limits["PriceGuide"]) * 1'000'000);
+#else
+    Q_UNUSED(limits)
+#endif
+}
+
+void Core::setPriceGuideConcurrentBatches(int count)
+{
+#if !defined(BS_BACKEND)
+    m_priceGuideCache->setMaxConcurrentBatches(count);
+#else
+    Q_UNUSED(count)
+#endif
+}
+
 QString Core::countryIdFromName(const QString &name) const
 {
     // BrickLink doesn't use the standard ISO country names...
@@ -835,31 +854,16 @@ const Color *Core::colorFromName(const QString &name) const
     if (name.isEmpty())
         return nullptr;
 
-    auto it = std::find_if(colors().cbegin(), colors().cend(), [name](const auto &color) {
-        return !color.name().compare(name, Qt::CaseInsensitive);
-    });
-    if (it != colors().cend())
-        return &(*it);
-    return nullptr;
+    return m_database->m_colorNameIndex.value(name.toCaseFolded());
 }
 
 
 const Color *Core::colorFromLDrawId(int ldrawId) const
 {
-    auto it = std::find_if(colors().cbegin(), colors().cend(), [ldrawId](const auto &color) {
-        return (color.ldrawId() == ldrawId);
-    });
-    if (it != colors().cend())
-        return &(*it);
-
-    const auto &extraColors = m_database->m_ldrawExtraColors;
-
-    it = std::find_if(extraColors.cbegin(), extraColors.cend(), [ldrawId](const auto &color) {
-        return (color.ldrawId() == ldrawId);
-    });
-    if (it != extraColors.cend())
-        return &(*it);
+    const auto &ldrawColors = m_database->m_ldrawColorIndex;
 
+    if ((ldrawId >= 0) && (size_t(ldrawId) < ldrawColors.size()))
+        return ldrawColors[size_t(ldrawId)];
     return nullptr;
 }
 
@@ -872,32 +876,51 @@ const ItemType *Core::itemType(char id) const
     return nullptr;
 }
 
-const Item *Core::item(char tid, const QByteArray &id) const
+const Item *Core::item(char tid, QByteArrayView id) const
 {
-    auto needle = std::make_pair(tid, id);
+    const auto *itt = itemType(tid);
+    if (!itt)
+        return nullptr;
+
+    // the index is only missing while the backend is still importing the items
+    if (!m_database->m_itemIndex.empty())
+        return m_database->findItem(uint(itt - itemTypes().data()), id);
+
+    auto needle = std::make_pair(tid, QByteArray::fromRawData(id.data(), id.size()));
     auto it = std::lower_bound(items().cbegin(), items().cend(), needle);
     if ((it != items().cend()) && (*it == needle))
         return &(*it);
     return nullptr;
 }
 
-const Item *Core::item(const std::string &tids, const QByteArray &id) const
+const Item *Core::item(const std::string &tids, QByteArrayView id) const
 {
     for (const char &tid : tids) {
-        auto needle = std::make_pair(tid, id);
-        auto it = std::lower_bound(items().cbegin(), items().cend(), needle);
-        if ((it != items().cend()) && (*it == needle))
-            return &(*it);
+        if (auto *it = item(tid, id))
+            return it;
     }
     return nullptr;
 }
 
+QBitArray Core::itemTextCandidates(const QStringList &terms) const
+{
+    return database()->itemTextCandidates(terms);
+}
+
+QBitArray Core::itemFacetCandidates(const ItemType *itemType, const Category *category,
+                                    const Color *color, int minYear, int maxYear) const
+{
+    return database()->itemFacetCandidates(itemType, category, color, minYear, maxYear);
+}
+
 std::tuple<const Item *, const Color *> Core::partColorCode(uint id) const
 {
-    for (const auto &item : items()) {
-        if (const auto *color = item.hasPCC(id))
-            return std::make_tuple(&item, color);
-    }
+    const auto &pccs = database()->m_pccIndex;
+    auto it = std::lower_bound(pccs.cbegin(), pccs.cend(), id, [](const auto &pcc, uint pccId) {
+        return pcc.m_id < pccId;
+    });
+    if ((it != pccs.cend()) && (it->m_id == id))
+        return std::make_tuple(&items()[it->m_itemIndex], &colors()[it->m_colorIndex]);
     return { nullptr, nullptr };
 }
 
@@ -97,11 +97,19 @@ public:
     const Color *colorFromLDrawId(int ldrawId) const;
     const Category *category(uint id) const;
     const ItemType *itemType(char id) const;
-    const Item *item(char tid, const QByteArray &id) const;
-    const Item *item(const std::string &tids, const QByteArray &id) const;
+    const Item *item(char tid, QByteArrayView id) const;
+    const Item *item(const std::string &tids, QByteArrayView id) const;
 
     std::tuple<const Item *, const Color *> partColorCode(uint id) const;
 
+    // a superset of the items whose search text contains all the terms (case-insensitive),
+    // or a null QBitArray if the terms are too short to narrow down the search
+    QBitArray itemTextCandidates(const QStringList &terms) const;
+    // the items matching all the given (non-null / non-zero) facets, or a null QBitArray
+    // if there are none
+    QBitArray itemFacetCandidates(const ItemType *itemType, const Category *category,
+                                  const Color *color, int minYear, int maxYear) const;
+
     const Relationship *relationship(uint id) const;
     const RelationshipMatch *relationshipMatch(uint id) const;
 
@@ -126,6 +134,8 @@ public:
 
 public slots:
     void setUpdateIntervals(const QMap<QByteArray, int> &intervals);
+    void setCacheSizeLimits(const QMap<QByteArray, int> &limits);
+    void setPriceGuideConcurrentBatches(int count);
 
     void cancelTransfers();
 
@@ -1,17 +1,24 @@
 // Copyright (C) 2004-2025 Robert Griebl
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <bit>
 #include <cstdio>
 #include <cstdlib>
+#include <functional>
 
 #include <QFile>
 #include <QBuffer>
+#include <QtEndian>
 #include <QSaveFile>
 #include <QFileInfo>
 #include <QDir>
 #include <QDirIterator>
 #include <QDebug>
 #include <QScopeGuard>
+#include <QCryptographicHash>
+#include <QThread>
+#include <QtConcurrentMap>
 
 #include "utility/stopwatch.h"
 #include "utility/chunkreader.h"
@@ -53,13 +60,25 @@ Database::Database(const QString &updateUrl, QObject *parent)
         auto *hhc = qobject_cast<HashHeaderCheckFilter *>(j->file());
         Q_ASSERT(hhc);
         auto *file = hhc->property("bsFile").value<QSaveFile *>();
-        Q_ASSERT(file);
+        auto *deltaBuffer = hhc->property("bsDeltaBuffer").value<QBuffer *>();
+        Q_ASSERT(file || deltaBuffer);
 
         hhc->close(); // does not close/commit the QSaveFile
         hhc->deleteLater();
 
         m_job = nullptr;
 
+        if (deltaBuffer) {
+            if (finishDeltaUpdate(j, hhc->hasValidChecksum(), deltaBuffer->data()))
+                return;
+            // the delta does not fit the local file: get the full database instead
+            if (startDownload(false, false))
+                return;
+            emit updateFinished(false, tr("Could not load the new database"));
+            setUpdateStatus(UpdateStatus::UpdateFailed);
+            return;
+        }
+
         try {
             if (!j->isFailed() && j->wasNotModified()) {
                 emit updateFinished(true, tr("Already up-to-date."));
@@ -130,7 +149,19 @@ void Database::clear()
     m_items.clear();
     m_itemChangelog.clear();
     m_colorChangelog.clear();
-    m_pool.reset();
+    m_pccIndex.clear();
+    m_colorNameIndex.clear();
+    m_ldrawColorIndex.clear();
+    m_itemIndex.clear();
+    m_itemTrigramIndex.clear();
+    m_itemsByItemType.clear();
+    m_itemsByCategory.clear();
+    m_itemsByColor.clear();
+    m_itemsByYearReleased.clear();
+    m_itemsByYearLastProduced.clear();
+    m_pools.clear();
+    m_mappedFile.reset();
+    m_fileData.reset();
 }
 
 bool Database::startUpdate()
@@ -143,31 +174,65 @@ bool Database::startUpdate(bool force)
     if (m_job || (updateStatus() == UpdateStatus::Updating))
         return false;
 
-    QString dbName = defaultDatabaseName();
-    QString remotefile = u"https://" + m_updateUrl + u'/' + dbName + u".lzma";
-    QString localfile = core()->dataPath() + dbName;
+    QString localfile = core()->dataPath() + defaultDatabaseName();
 
     if (!QFile::exists(localfile))
         force = true;
 
     if (m_etag.isEmpty()) {
-        QString dbfile = core()->dataPath() + Database::defaultDatabaseName();
-        QFile etagf(dbfile + u".etag");
+        QFile etagf(localfile + u".etag");
         if (etagf.open(QIODevice::ReadOnly))
             m_etag = QString::fromUtf8(etagf.readAll());
     }
+    if (m_deltaEtag.isEmpty()) {
+        QFile etagf(localfile + u".delta.etag");
+        if (etagf.open(QIODevice::ReadOnly))
+            m_deltaEtag = QString::fromUtf8(etagf.readAll());
+    }
+
+    // try the small delta to the previous version first, if we have a local database at all
+    if (!startDownload(!force, force))
+        return false;
+
+    setUpdateStatus(UpdateStatus::Updating);
+
+    emit databaseAboutToBeReset();
+    return true;
+}
+
+QString Database::remoteUrl(const QString &fileName) const
+{
+    // a full URL can point to a local stand-in for the update server
+    if (m_updateUrl.contains(u"://"))
+        return m_updateUrl + u'/' + fileName;
+    return u"https://" + m_updateUrl + u'/' + fileName;
+}
+
+bool Database::startDownload(bool delta, bool force)
+{
+    QString dbName = defaultDatabaseName();
+    QString remotefile = remoteUrl(dbName + (delta ? u".delta.lzma" : u".lzma"));
+    QString localfile = core()->dataPath() + dbName;
+
+    QIODevice *target;
+    if (delta)
+        target = new QBuffer();
+    else
+        target = new QSaveFile(localfile);
 
-    auto file = new QSaveFile(localfile);
-    auto lzma = new LZMA::DecompressFilter(file);
+    auto lzma = new LZMA::DecompressFilter(target);
     auto hhc = new HashHeaderCheckFilter(lzma);
     lzma->setParent(hhc);
-    file->setParent(lzma);
-    hhc->setProperty("bsFile", QVariant::fromValue(file));
+    target->setParent(lzma);
+    if (delta)
+        hhc->setProperty("bsDeltaBuffer", QVariant::fromValue(static_cast<QBuffer *>(target)));
+    else
+        hhc->setProperty("bsFile", QVariant::fromValue(static_cast<QSaveFile *>(target)));
 
     if (hhc->open(QIODevice::WriteOnly)) {
         m_job = TransferJob::get(remotefile);
         if (!force)
-            m_job->setOnlyIfDifferent(m_etag);
+            m_job->setOnlyIfDifferent(delta ? m_deltaEtag : m_etag);
         m_job->setOutputDevice(hhc);
         m_transfer->retrieve(m_job);
     }
@@ -175,11 +240,59 @@ bool Database::startUpdate(bool force)
         delete hhc;
         return false;
     }
+    return true;
+}
 
-    setUpdateStatus(UpdateStatus::Updating);
+// returns false if the full database needs to be downloaded instead
+bool Database::finishDeltaUpdate(TransferJob *job, bool validChecksum, const QByteArray &delta)
+{
+    if (!job->isFailed() && job->wasNotModified()) {
+        emit updateFinished(true, tr("Already up-to-date."));
+        setUpdateStatus(UpdateStatus::Ok);
+        emit databaseReset();
+        return true;
+    }
+    if (job->isFailed() || !validChecksum)
+        return false;
 
-    emit databaseAboutToBeReset();
-    return true;
+    try {
+        const QString fileName = core()->dataPath() + defaultDatabaseName();
+
+        QFile f(fileName);
+        if (!f.open(QIODevice::ReadOnly))
+            throw Exception(&f, "could not open database for reading");
+        const QByteArray base = f.readAll();
+        f.close();
+
+        const QByteArray updated = applyDelta(base, delta);
+        if (!updated.isEmpty()) {
+            QSaveFile sf(fileName);
+            if (!sf.open(QIODevice::WriteOnly) || (sf.write(updated) != updated.size()) || !sf.commit())
+                throw Exception(&sf, "could not write the updated database");
+
+            read(fileName);
+
+            // we don't know the ETag of the matching full download
+            m_etag.clear();
+            QFile::remove(fileName + u".etag");
+        }
+
+        m_deltaEtag = job->lastETag();
+        QFile etagf(fileName + u".delta.etag");
+        if (etagf.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            etagf.write(m_deltaEtag.toUtf8());
+            etagf.close();
+        }
+
+        emit updateFinished(true, updated.isEmpty() ? tr("Already up-to-date.") : QString { });
+        setUpdateStatus(UpdateStatus::Ok);
+        emit databaseReset();
+        return true;
+
+    } catch (const Exception &e) {
+        qWarning() << "Applying the database delta failed:" << e.errorString();
+        return false;
+    }
 }
 
 void Database::cancelUpdate()
@@ -193,23 +306,37 @@ void Database::read(const QString &fileName)
     try {
         auto *sw = new stopwatch("Loading database");
 
-        QFile f(!fileName.isEmpty() ? fileName : core()->dataPath() + Database::defaultDatabaseName());
+        // The V13+ record tables point directly into the file data, so we need to keep it
+        // alive for as long as the loaded database is in use.
+        auto file = std::make_unique<QFile>(!fileName.isEmpty() ? fileName : core()->dataPath() + Database::defaultDatabaseName());
+        QFile &f = *file;
 
         if (!f.open(QFile::ReadOnly))
             throw Exception(&f, "could not open database for reading");
 
-        const char *data = reinterpret_cast<char *>(f.map(0, f.size()));
+        const qint64 dataSize = f.size();
+        std::unique_ptr<char[]> fileData;
+
+#if defined(Q_OS_WINDOWS)
+        // Windows refuses to replace a file that is still mapped, which would break the next
+        // database update. Read it in one go instead, which still avoids per-record copies.
+        fileData.reset(new char[size_t(dataSize)]);
+        if (f.read(fileData.get(), dataSize) != dataSize)
+            throw Exception(&f, "could not read the database");
+        f.close();
+        const char *data = fileData.get();
+#else
+        const char *data = reinterpret_cast<char *>(f.map(0, dataSize));
+#endif
 
         if (!data)
             throw Exception("could not memory map the database (%1)").arg(f.fileName());
 
-        QByteArray ba = QByteArray::fromRawData(data, int(f.size()));
+        QByteArray ba = QByteArray::fromRawData(data, int(dataSize));
         QBuffer buf(&ba);
         buf.open(QIODevice::ReadOnly);
         ChunkReader cr(&buf, QDataStream::LittleEndian);
-        QDataStream &ds = cr.dataStream();
 
-        ds.startTransaction();
         cr.startChunk();
 
         if (cr.chunkId() != ChunkId("BSDB"))
@@ -220,24 +347,19 @@ void Database::read(const QString &fileName)
                 .arg(int(Version::Latest)).arg(cr.chunkVersion());
         }
 
+        // Only the chunk headers are read here: the actual decoding happens below, in parallel
+        const auto directory = cr.readChunkDirectory();
+        cr.endChunk();
+
+        sw->restart("Loading database: decoding chunks");
+
         bool gotColors = false, gotCategories = false, gotItemTypes = false, gotItems = false;
         bool gotChangeLog = false, gotRelationships = false, gotRelationshipMatches = false;
         bool gotApiKeys = false, gotApiQuirks = false;
 
-        auto check = [&ds, &f]() {
-            if (ds.status() != QDataStream::Ok)
-                throw Exception("failed to read from database (%1) at position %2")
-                    .arg(f.fileName()).arg(ds.device()->pos());
-        };
-
-        auto sizeCheck = [&f](uint s, uint max) {
-            if (s > max)
-                throw Exception("failed to read from database (%1) at position %2: size value %L3 is larger than expected maximum %L4")
-                    .arg(f.fileName()).arg(f.pos()).arg(s).arg(max);
-        };
-
-        // This is the new pool. We need to keep the old alive till the scope end
-        std::unique_ptr<MemoryResource> pool(new DatabaseMonotonicMemoryResource(1024*1024));
+        // These are the new pools, one per decoded chunk, so that the decoders do not have to
+        // share an allocator. We need to keep the old ones alive till the scope end
+        std::vector<std::unique_ptr<MemoryResource>> pools;
 
         QDateTime                        generationDate;
         std::vector<Color>               colors;
@@ -253,173 +375,285 @@ void Database::read(const QString &fileName)
         QHash<QByteArray, QString>       apiKeys;
         QSet<ApiQuirk>                   apiQuirks;
 
-        while (cr.startChunk()) {
-            switch (cr.chunkIdAndVersion()) {
+        // Every job writes to exactly one of the containers above, so they can run concurrently.
+        // Exceptions are collected per job and re-thrown on this thread afterwards.
+        struct DecodeJob {
+            std::function<void()> decode;
+            std::exception_ptr error;
+        };
+        std::vector<DecodeJob> jobs;
+
+        auto chunkData = [&](const ChunkReader::ChunkInfo &ci) {
+            return QByteArrayView(data + ci.startpos, ci.size);
+        };
+
+        // the pre-V13 chunks need to be streamed, using a private QDataStream and pool
+        auto addStreamJob = [&](const ChunkReader::ChunkInfo &ci, bool needsPool, auto decode) {
+            MemoryResource *pool = nullptr;
+            if (needsPool)
+                pool = pools.emplace_back(new DatabaseMonotonicMemoryResource(1024*1024)).get();
+
+            jobs.push_back({ [=, &f]() {
+                QByteArray chunkBa = QByteArray::fromRawData(data + ci.startpos, int(ci.size));
+                QBuffer chunkBuf(&chunkBa);
+                chunkBuf.open(QIODevice::ReadOnly);
+                QDataStream ds(&chunkBuf);
+                ds.setVersion(QDataStream::Qt_5_11);
+                ds.setByteOrder(QDataStream::LittleEndian);
+
+                auto check = [&]() {
+                    if (ds.status() != QDataStream::Ok)
+                        throw Exception("failed to read from database (%1) at position %2")
+                            .arg(f.fileName()).arg(ci.startpos + chunkBuf.pos());
+                };
+
+                auto sizeCheck = [&](uint s, uint max) {
+                    if (s > max)
+                        throw Exception("failed to read from database (%1) at position %2: size value %L3 is larger than expected maximum %L4")
+                            .arg(f.fileName()).arg(ci.startpos + chunkBuf.pos()).arg(s).arg(max);
+                };
+
+                decode(ds, pool, check, sizeCheck);
+                check();
+            }, { } });
+        };
+
+        auto addTableJob = [&](auto decode) {
+            jobs.push_back({ decode, { } });
+        };
+
+        QSet<quint32> seenChunkIds;
+
+        for (const auto &ci : directory) {
+            const auto idAndVersion = ci.idAndVersion();
+
+            // two decoders writing into the same container would race
+            if (seenChunkIds.contains(ci.id)) {
+                throw Exception("duplicate chunk %1 in database (%2)")
+                    .arg(QString::fromLatin1(reinterpret_cast<const char *>(&ci.id), 4))
+                    .arg(f.fileName());
+            }
+            seenChunkIds.insert(ci.id);
+
+            switch (idAndVersion) {
             case ChunkIdAndVersion("DATE", 1): {
-                ds >> generationDate;
+                addStreamJob(ci, false, [&](QDataStream &ds, MemoryResource *, auto, auto) {
+                    ds >> generationDate;
+                });
                 break;
             }
             case ChunkIdAndVersion("COL ", 1): {
-                quint32 colc = 0;
-                ds >> colc;
-                check();
-                sizeCheck(colc, 1'000);
-
-                colors.resize(colc);
-                for (quint32 i = 0; i < colc; ++i) {
-                    readColorFromDatabase(colors[i], ds, pool.get());
+                addStreamJob(ci, true, [&](QDataStream &ds, MemoryResource *pool, auto check, auto sizeCheck) {
+                    quint32 colc = 0;
+                    ds >> colc;
                     check();
-                }
+                    sizeCheck(colc, 1'000);
+
+                    colors.resize(colc);
+                    for (quint32 i = 0; i < colc; ++i) {
+                        readColorFromDatabase(colors[i], ds, pool);
+                        check();
+                    }
+                });
+                gotColors = true;
+                break;
+            }
+            case ChunkIdAndVersion("COL ", 2): {
+                addTableJob([&, ci]() { readColorTableFromDatabase(colors, chunkData(ci)); });
                 gotColors = true;
                 break;
             }
+            case ChunkIdAndVersion("LCOL", 2): { // optional, can be missing or empty
+                addTableJob([&, ci]() { readColorTableFromDatabase(ldrawExtraColors, chunkData(ci)); });
+                break;
+            }
             case ChunkIdAndVersion("LCOL", 1): { // optional, can be missing or empty
-                quint32 colc = 0;
-                ds >> colc;
-                check();
-                sizeCheck(colc, 1'000);
-
-                ldrawExtraColors.resize(colc);
-                for (quint32 i = 0; i < colc; ++i) {
-                    readColorFromDatabase(ldrawExtraColors[i], ds, pool.get());
+                addStreamJob(ci, true, [&](QDataStream &ds, MemoryResource *pool, auto check, auto sizeCheck) {
+                    quint32 colc = 0;
+                    ds >> colc;
                     check();
-                }
+                    sizeCheck(colc, 1'000);
+
+                    ldrawExtraColors.resize(colc);
+                    for (quint32 i = 0; i < colc; ++i) {
+                        readColorFromDatabase(ldrawExtraColors[i], ds, pool);
+                        check();
+                    }
+                });
                 break;
             }
             case ChunkIdAndVersion("CAT ", 1): {
-                quint32 catc = 0;
-                ds >> catc;
-                check();
-                sizeCheck(catc, 10'000);
-
-                categories.resize(catc);
-                for (quint32 i = 0; i < catc; ++i) {
-                    readCategoryFromDatabase(categories[i], ds, pool.get());
+                addStreamJob(ci, true, [&](QDataStream &ds, MemoryResource *pool, auto check, auto sizeCheck) {
+                    quint32 catc = 0;
+                    ds >> catc;
                     check();
-                }
+                    sizeCheck(catc, 10'000);
+
+                    categories.resize(catc);
+                    for (quint32 i = 0; i < catc; ++i) {
+                        readCategoryFromDatabase(categories[i], ds, pool);
+                        check();
+                    }
+                });
+                gotCategories = true;
+                break;
+            }
+            case ChunkIdAndVersion("CAT ", 2): {
+                addTableJob([&, ci]() { readCategoryTableFromDatabase(categories, chunkData(ci)); });
                 gotCategories = true;
                 break;
             }
             case ChunkIdAndVersion("TYPE", 1): {
-                quint32 ittc = 0;
-                ds >> ittc;
-                check();
-                sizeCheck(ittc, 20);
-
-                itemTypes.resize(ittc);
-                for (quint32 i = 0; i < ittc; ++i) {
-                    readItemTypeFromDatabase(itemTypes[i], ds, pool.get());
+                addStreamJob(ci, true, [&](QDataStream &ds, MemoryResource *pool, auto check, auto sizeCheck) {
+                    quint32 ittc = 0;
+                    ds >> ittc;
                     check();
-                }
+                    sizeCheck(ittc, 20);
+
+                    itemTypes.resize(ittc);
+                    for (quint32 i = 0; i < ittc; ++i) {
+                        readItemTypeFromDatabase(itemTypes[i], ds, pool);
+                        check();
+                    }
+                });
                 gotItemTypes = true;
                 break;
             }
             case ChunkIdAndVersion("ITEM", 1): {
-                quint32 itc = 0;
-                ds >> itc;
-                check();
-                sizeCheck(itc, 1'000'000);
-
-                items.resize(itc);
-                for (quint32 i = 0; i < itc; ++i) {
-                    readItemFromDatabase(items[i], ds, pool.get());
+                addStreamJob(ci, true, [&](QDataStream &ds, MemoryResource *pool, auto check, auto sizeCheck) {
+                    quint32 itc = 0;
+                    ds >> itc;
                     check();
+                    sizeCheck(itc, 1'000'000);
+
+                    items.resize(itc);
+                    for (quint32 i = 0; i < itc; ++i) {
+                        readItemFromDatabase(items[i], ds, pool);
+                        check();
+                    }
+                });
+                gotItems = true;
+                break;
+            }
+            case ChunkIdAndVersion("ITEM", 2): {
+                // the item table is by far the largest one: split it into record ranges, so
+                // that it can be filled by multiple threads at once
+                const qsizetype itc = readItemTableSizeFromDatabase(chunkData(ci));
+                items.resize(size_t(itc));
+
+                const qsizetype rangeSize = std::max(qsizetype(4096),
+                                                     itc / (4 * std::max(1, QThread::idealThreadCount())) + 1);
+                for (qsizetype from = 0; from < itc; from += rangeSize) {
+                    const qsizetype to = std::min(itc, from + rangeSize);
+                    addTableJob([&, ci, from, to]() {
+                        readItemTableFromDatabase(items, chunkData(ci), from, to);
+                    });
                 }
                 gotItems = true;
                 break;
             }
             case ChunkIdAndVersion("CHGL", 2): {
-                quint32 clid = 0, clic = 0, clcc = 0;
-                ds >> clid >> clic >> clcc;
-                check();
-                sizeCheck(clic, 1'000'000);
-                sizeCheck(clcc, 1'000);
-
-                itemChangelog.resize(clic);
-                for (quint32 i = 0; i < clic; ++i) {
-                    readItemChangeLogFromDatabase(itemChangelog[i], ds, pool.get());
+                addStreamJob(ci, true, [&](QDataStream &ds, MemoryResource *pool, auto check, auto sizeCheck) {
+                    quint32 clid = 0, clic = 0, clcc = 0;
+                    ds >> clid >> clic >> clcc;
                     check();
-                }
-                colorChangelog.resize(clcc);
-                for (quint32 i = 0; i < clcc; ++i) {
-                    readColorChangeLogFromDatabase(colorChangelog[i], ds, pool.get());
-                    check();
-                }
-                latestChangelogId = clid;
+                    sizeCheck(clic, 1'000'000);
+                    sizeCheck(clcc, 1'000);
+
+                    itemChangelog.resize(clic);
+                    for (quint32 i = 0; i < clic; ++i) {
+                        readItemChangeLogFromDatabase(itemChangelog[i], ds, pool);
+                        check();
+                    }
+                    colorChangelog.resize(clcc);
+                    for (quint32 i = 0; i < clcc; ++i) {
+                        readColorChangeLogFromDatabase(colorChangelog[i], ds, pool);
+                        check();
+                    }
+                    latestChangelogId = clid;
+                });
+                gotChangeLog = true;
+                break;
+            }
+            case ChunkIdAndVersion("CHGL", 3): {
+                addTableJob([&, ci]() {
+                    latestChangelogId = readChangeLogTableFromDatabase(itemChangelog, colorChangelog,
+                                                                       chunkData(ci));
+                });
                 gotChangeLog = true;
                 break;
             }
             case ChunkIdAndVersion("REL ", 1): {
-                quint32 relc = 0;
-                ds >> relc;
-                check();
-                sizeCheck(relc, 1'000);
-
-                relationships.resize(relc);
-                for (quint32 i = 0; i < relc; ++i) {
-                    readRelationshipFromDatabase(relationships[i], ds, pool.get());
+                addStreamJob(ci, true, [&](QDataStream &ds, MemoryResource *pool, auto check, auto sizeCheck) {
+                    quint32 relc = 0;
+                    ds >> relc;
                     check();
-                }
+                    sizeCheck(relc, 1'000);
+
+                    relationships.resize(relc);
+                    for (quint32 i = 0; i < relc; ++i) {
+                        readRelationshipFromDatabase(relationships[i], ds, pool);
+                        check();
+                    }
+                });
                 gotRelationships = true;
                 break;
             }
             case ChunkIdAndVersion("RELM", 1): {
-                quint32 matchc = 0;
-                ds >> matchc;
-                check();
-                sizeCheck(matchc, 1'000'000);
-
-                relationshipMatches.resize(matchc);
-                for (quint32 i = 0; i < matchc; ++i) {
-                    readRelationshipMatchFromDatabase(relationshipMatches[i], ds, pool.get());
+                addStreamJob(ci, true, [&](QDataStream &ds, MemoryResource *pool, auto check, auto sizeCheck) {
+                    quint32 matchc = 0;
+                    ds >> matchc;
                     check();
-                }
+                    sizeCheck(matchc, 1'000'000);
+
+                    relationshipMatches.resize(matchc);
+                    for (quint32 i = 0; i < matchc; ++i) {
+                        readRelationshipMatchFromDatabase(relationshipMatches[i], ds, pool);
+                        check();
+                    }
+                });
                 gotRelationshipMatches = true;
                 break;
             }
             case ChunkIdAndVersion("AKEY", 1): {
-                quint32 akeyc = 0;
-                ds >> akeyc;
-                check();
-                sizeCheck(akeyc, 100);
-
-                for (quint32 i = 0; i < akeyc; ++i) {
-                    QByteArray id;
-                    QString key;
-                    readApiKeyFromDatabase(id, key, ds, pool.get());
+                addStreamJob(ci, false, [&](QDataStream &ds, MemoryResource *pool, auto check, auto sizeCheck) {
+                    quint32 akeyc = 0;
+                    ds >> akeyc;
                     check();
-                    apiKeys.insert(id, key);
-                }
+                    sizeCheck(akeyc, 100);
+
+                    for (quint32 i = 0; i < akeyc; ++i) {
+                        QByteArray id;
+                        QString key;
+                        readApiKeyFromDatabase(id, key, ds, pool);
+                        check();
+                        apiKeys.insert(id, key);
+                    }
+                });
                 gotApiKeys = true;
                 break;
             }
             case ChunkIdAndVersion("QIRK", 1): {
-                quint32 qkeyc = 0;
-                ds >> qkeyc;
-                check();
-                sizeCheck(qkeyc, 100);
-
-                for (quint32 i = 0; i < qkeyc; ++i) {
-                    quint32 quirk;
-                    ds >> quirk;
+                addStreamJob(ci, false, [&](QDataStream &ds, MemoryResource *, auto check, auto sizeCheck) {
+                    quint32 qkeyc = 0;
+                    ds >> qkeyc;
                     check();
-                    apiQuirks.insert(static_cast<BrickLink::ApiQuirk>(quirk));
-                }
+                    sizeCheck(qkeyc, 100);
+
+                    for (quint32 i = 0; i < qkeyc; ++i) {
+                        quint32 quirk;
+                        ds >> quirk;
+                        check();
+                        apiQuirks.insert(static_cast<BrickLink::ApiQuirk>(quirk));
+                    }
+                });
                 gotApiQuirks = true;
                 break;
             }
-            default: {
-                cr.skipChunk();
-                check();
+            default:
                 break;
             }
-            }
-            cr.endChunk();
         }
-        cr.endChunk();
-        ds.commitTransaction();
-
-        delete sw;
 
         if (!gotColors || !gotCategories || !gotItemTypes || !gotItems || !gotChangeLog
             || !gotRelationships || !gotRelationshipMatches || !gotApiKeys) {
@@ -427,6 +661,20 @@ void Database::read(const QString &fileName)
                 .arg(f.fileName());
         }
 
+        QtConcurrent::blockingMap(jobs, [](DecodeJob &job) {
+            try {
+                job.decode();
+            } catch (...) {
+                job.error = std::current_exception();
+            }
+        });
+        for (const auto &job : jobs) {
+            if (job.error)
+                std::rethrow_exception(job.error);
+        }
+
+        delete sw;
+
         m_colors = std::move(colors);
         m_ldrawExtraColors = std::move(ldrawExtraColors);
         m_categories = std::move(categories);
@@ -438,11 +686,15 @@ void Database::read(const QString &fileName)
         m_relationshipMatches = std::move(relationshipMatches);
         m_latestChangelogId = latestChangelogId;
         m_apiKeys = apiKeys;
+        buildIndexes();
+
         const auto oldQuirks = m_apiQuirks;
         m_apiQuirks = gotApiQuirks ? apiQuirks.intersect(Core::knownApiQuirks())
                                    : Core::knownApiQuirks();
 
-        m_pool.swap(pool);
+        m_pools.swap(pools);
+        m_mappedFile.swap(file);
+        m_fileData.swap(fileData);
 
         Color::s_colorImageCache.clear();
 
@@ -521,6 +773,149 @@ QString Database::dumpDatabaseInformation(const QString &title, bool itemTypeInf
 }
 
 
+/* The delta is a chunk file itself:
+     BSDD
+       HASH: BSDB version, SHA512 of the base file, SHA512 of the target file
+       for every top-level chunk of the target, in order:
+         either a COPY chunk with the id and version of an identical chunk in the base,
+         or the target chunk itself
+
+   Without a base, the base hash is empty and no chunks follow: this tells every client that
+   is not already up-to-date to download the full database instead.
+*/
+
+static QVector<ChunkReader::ChunkInfo> databaseDirectory(const QByteArray &data, quint32 *version)
+{
+    QBuffer buf;
+    buf.setData(data);
+    buf.open(QIODevice::ReadOnly);
+    ChunkReader cr(&buf, QDataStream::LittleEndian);
+
+    if (!cr.startChunk() || (cr.chunkId() != ChunkId("BSDB")))
+        throw Exception("invalid database format - wrong magic");
+    *version = cr.chunkVersion();
+    const auto directory = cr.readChunkDirectory();
+    cr.endChunk();
+    return directory;
+}
+
+QByteArray Database::createDelta(const QByteArray &base, const QByteArray &target)
+{
+    quint32 baseVersion = 0;
+    quint32 targetVersion = 0;
+    const auto targetDirectory = databaseDirectory(target, &targetVersion);
+
+    QHash<quint64, QByteArrayView> baseChunks;
+    if (!base.isEmpty()) {
+        for (const auto &ci : databaseDirectory(base, &baseVersion))
+            baseChunks.insert(ci.idAndVersion(), QByteArrayView(base).sliced(ci.startpos, ci.size));
+    }
+
+    QByteArray delta;
+    QBuffer buf(&delta);
+    buf.open(QIODevice::WriteOnly);
+    ChunkWriter cw(&buf, QDataStream::LittleEndian);
+    QDataStream &ds = cw.dataStream();
+
+    cw.startChunk("BSDD", 1);
+
+    cw.startChunk("HASH", 1);
+    ds << targetVersion
+       << (base.isEmpty() ? QByteArray { } : QCryptographicHash::hash(base, QCryptographicHash::Sha512))
+       << QCryptographicHash::hash(target, QCryptographicHash::Sha512);
+    cw.endChunk();
+
+    if (!base.isEmpty()) {
+        for (const auto &ci : targetDirectory) {
+            const auto data = QByteArrayView(target).sliced(ci.startpos, ci.size);
+            const auto it = baseChunks.constFind(ci.idAndVersion());
+
+            if ((it != baseChunks.cend()) && (*it == data)) {
+                cw.startChunk("COPY", 1);
+                ds << ci.id << ci.version;
+                cw.endChunk();
+            } else {
+                cw.startChunk(ci.id, ci.version);
+                ds.writeRawData(data.data(), int(data.size()));
+                cw.endChunk();
+            }
+        }
+    }
+    cw.endChunk();
+    buf.close();
+    return delta;
+}
+
+QByteArray Database::applyDelta(const QByteArray &base, const QByteArray &delta)
+{
+    QBuffer deltaBuf;
+    deltaBuf.setData(delta);
+    deltaBuf.open(QIODevice::ReadOnly);
+    ChunkReader cr(&deltaBuf, QDataStream::LittleEndian);
+    QDataStream &crs = cr.dataStream();
+
+    if (!cr.startChunk() || (cr.chunkIdAndVersion() != ChunkIdAndVersion("BSDD", 1)))
+        throw Exception("invalid database delta format - wrong magic");
+    if (!cr.startChunk() || (cr.chunkIdAndVersion() != ChunkIdAndVersion("HASH", 1)))
+        throw Exception("invalid database delta format - missing hashes");
+
+    quint32 targetVersion = 0;
+    QByteArray baseHash, targetHash;
+    crs >> targetVersion >> baseHash >> targetHash;
+    cr.endChunk();
+
+    const QByteArray localHash = QCryptographicHash::hash(base, QCryptographicHash::Sha512);
+    if (localHash == targetHash)
+        return { };
+    if (baseHash.isEmpty())
+        throw Exception("the database delta requires a full download");
+    if (localHash != baseHash)
+        throw Exception("the database delta does not apply to the local database");
+
+    const auto directory = cr.readChunkDirectory();
+    cr.endChunk();
+
+    quint32 baseVersion = 0;
+    QHash<quint64, QByteArrayView> baseChunks;
+    for (const auto &ci : databaseDirectory(base, &baseVersion))
+        baseChunks.insert(ci.idAndVersion(), QByteArrayView(base).sliced(ci.startpos, ci.size));
+
+    QByteArray target;
+    target.reserve(base.size());
+    QBuffer buf(&target);
+    buf.open(QIODevice::WriteOnly);
+    ChunkWriter cw(&buf, QDataStream::LittleEndian);
+    QDataStream &ds = cw.dataStream();
+
+    cw.startChunk("BSDB", targetVersion);
+
+    for (const auto &ci : directory) {
+        QByteArrayView data(delta.constData() + ci.startpos, ci.size);
+        quint32 id = ci.id;
+        quint32 version = ci.version;
+
+        if (ci.idAndVersion() == ChunkIdAndVersion("COPY", 1)) {
+            QDataStream copyDs(delta.sliced(ci.startpos, ci.size));
+            copyDs.setByteOrder(QDataStream::LittleEndian);
+            copyDs >> id >> version;
+
+            const auto it = baseChunks.constFind(quint64(id) | (quint64(version) << 32));
+            if ((copyDs.status() != QDataStream::Ok) || (it == baseChunks.cend()))
+                throw Exception("the database delta references a missing chunk");
+            data = *it;
+        }
+        cw.startChunk(id, version);
+        ds.writeRawData(data.data(), int(data.size()));
+        cw.endChunk();
+    }
+    cw.endChunk();
+    buf.close();
+
+    if (QCryptographicHash::hash(target, QCryptographicHash::Sha512) != targetHash)
+        throw Exception("checksum mismatch after applying the database delta");
+    return target;
+}
+
 void Database::write(const QString &filename, Version version) const
 {
     if (version <= Version::Invalid)
@@ -541,13 +936,23 @@ void Database::write(const QString &filename, Version version) const
     ds << QDateTime::currentDateTimeUtc();
     cw.endChunk();
 
-    cw.startChunk("COL ", 1);
-    ds << quint32(m_colors.size());
-    for (const Color &col : m_colors)
-        writeColorToDatabase(col, ds, version);
-    cw.endChunk();
+    if (version >= Version::V13) {
+        cw.startChunk("COL ", 2);
+        writeColorTableToDatabase(m_colors, ds);
+        cw.endChunk();
+    } else {
+        cw.startChunk("COL ", 1);
+        ds << quint32(m_colors.size());
+        for (const Color &col : m_colors)
+            writeColorToDatabase(col, ds, version);
+        cw.endChunk();
+    }
 
-    if ((version >= Version::V7) && !m_ldrawExtraColors.empty()) {
+    if ((version >= Version::V13) && !m_ldrawExtraColors.empty()) {
+        cw.startChunk("LCOL", 2);
+        writeColorTableToDatabase(m_ldrawExtraColors, ds);
+        cw.endChunk();
+    } else if ((version >= Version::V7) && !m_ldrawExtraColors.empty()) {
         cw.startChunk("LCOL", 1);
         ds << quint32(m_ldrawExtraColors.size());
         for (const Color &col : m_ldrawExtraColors)
@@ -555,11 +960,17 @@ void Database::write(const QString &filename, Version version) const
         cw.endChunk();
     }
 
-    cw.startChunk("CAT ", 1);
-    ds << quint32(m_categories.size());
-    for (const Category &cat : m_categories)
-        writeCategoryToDatabase(cat, ds, version);
-    cw.endChunk();
+    if (version >= Version::V13) {
+        cw.startChunk("CAT ", 2);
+        writeCategoryTableToDatabase(m_categories, ds);
+        cw.endChunk();
+    } else {
+        cw.startChunk("CAT ", 1);
+        ds << quint32(m_categories.size());
+        for (const Category &cat : m_categories)
+            writeCategoryToDatabase(cat, ds, version);
+        cw.endChunk();
+    }
 
     cw.startChunk("TYPE", 1);
     ds << quint32(m_itemTypes.size());
@@ -567,13 +978,23 @@ void Database::write(const QString &filename, Version version) const
         writeItemTypeToDatabase(itt, ds, version);
     cw.endChunk();
 
-    cw.startChunk("ITEM", 1);
-    ds << quint32(m_items.size());
-    for (const Item &item : m_items)
-        writeItemToDatabase(item, ds, version);
-    cw.endChunk();
+    if (version >= Version::V13) {
+        cw.startChunk("ITEM", 2);
+        writeItemTableToDatabase(m_items, ds);
+        cw.endChunk();
+    } else {
+        cw.startChunk("ITEM", 1);
+        ds << quint32(m_items.size());
+        for (const Item &item : m_items)
+            writeItemToDatabase(item, ds, version);
+        cw.endChunk();
+    }
 
-    if (version >= Version::V9) {
+    if (version >= Version::V13) {
+        cw.startChunk("CHGL", 3);
+        writeChangeLogTableToDatabase(ds);
+        cw.endChunk();
+    } else if (version >= Version::V9) {
         cw.startChunk("CHGL", 2);
         ds << quint32(m_latestChangelogId)
            << quint32(m_itemChangelog.size())
@@ -598,22 +1019,10 @@ void Database::write(const QString &filename, Version version) const
     }
 
     if (version < Version::V11) {
-        // we need to recalculate the pcc list used in older BS versions from the items
-        std::vector<PartColorCode> oldPccs;
-        for (const auto &item : m_items) {
-            for (const auto &newPcc : item.pccs()) {
-                PartColorCode oldPcc;
-                oldPcc.m_id = newPcc.pcc();
-                oldPcc.m_itemIndex = item.index();
-                oldPcc.m_colorIndex = newPcc.m_colorIndex;
-                oldPccs.push_back(oldPcc);
-            }
-        }
-        std::sort(oldPccs.begin(), oldPccs.end());
-
+        // older BS versions used a global pcc list, which is the same as our lookup index
         cw.startChunk("PCC ", 1);
-        ds << quint32(oldPccs.size());
-        for (const PartColorCode &pcc : std::as_const(oldPccs))
+        ds << quint32(m_pccIndex.size());
+        for (const PartColorCode &pcc : m_pccIndex)
             writePCCToDatabase(pcc, ds, version);
         cw.endChunk();
     }
@@ -654,6 +1063,253 @@ void Database::write(const QString &filename, Version version) const
         throw Exception(f.errorString());
 }
 
+void Database::buildIndexes()
+{
+    // PCCs are unique per item, but not globally: the stable sort keeps the first item's
+    // PCC in front, just like a linear search over all items would
+    m_pccIndex.clear();
+    for (size_t i = 0; i < m_items.size(); ++i) {
+        for (const auto &itemPcc : m_items[i].pccs()) {
+            PartColorCode pcc;
+            pcc.m_id = itemPcc.pcc();
+            pcc.m_itemIndex = int(i);
+            pcc.m_colorIndex = itemPcc.m_colorIndex;
+            m_pccIndex.push_back(pcc);
+        }
+    }
+    std::stable_sort(m_pccIndex.begin(), m_pccIndex.end());
+
+    // Color lookups by name or LDraw id happen for every imported lot and every rendered
+    // LDraw element. The first match wins, with the BrickLink colors taking precedence over the
+    // LDraw-only ones, just like the linear searches did.
+    m_colorNameIndex.clear();
+    m_colorNameIndex.reserve(qsizetype(m_colors.size()));
+    m_ldrawColorIndex.clear();
+
+    for (const auto *colors : { &m_colors, &m_ldrawExtraColors }) {
+        for (const Color &color : *colors) {
+            if (colors == &m_colors) {
+                const QString name = color.name().toCaseFolded();
+                if (!name.isEmpty() && !m_colorNameIndex.contains(name))
+                    m_colorNameIndex.insert(name, &color);
+            }
+            const int ldrawId = color.ldrawId();
+            if ((ldrawId >= 0) && (ldrawId < MaxIndexedLDrawColorId)) {
+                if (size_t(ldrawId) >= m_ldrawColorIndex.size())
+                    m_ldrawColorIndex.resize(size_t(ldrawId) + 1);
+                if (!m_ldrawColorIndex[size_t(ldrawId)])
+                    m_ldrawColorIndex[size_t(ldrawId)] = &color;
+            }
+        }
+    }
+
+    // only needed for the item browser's filters, so these are built on demand
+    m_itemTrigramIndex.clear();
+    m_itemsByItemType.clear();
+    m_itemsByCategory.clear();
+    m_itemsByColor.clear();
+    m_itemsByYearReleased.clear();
+    m_itemsByYearLastProduced.clear();
+
+    // Item lookups by (type, id) are the hot path of every import. The binary search over
+    // m_items compares strings in a different cache line on every step, while this hash table
+    // only touches the item data once the full hash matched.
+    m_itemIndex.clear();
+    if (!m_items.empty()) {
+        const size_t slotCount = std::bit_ceil(m_items.size() * 2);
+        m_itemIndex.resize(slotCount, { 0, -1 });
+
+        for (size_t i = 0; i < m_items.size(); ++i) {
+            const Item &item = m_items[i];
+            const quint32 hash = itemIndexHash(item.m_itemTypeIndex, item.id());
+
+            for (size_t slot = hash & (slotCount - 1); ; slot = (slot + 1) & (slotCount - 1)) {
+                if (m_itemIndex[slot].itemIndex < 0) {
+                    m_itemIndex[slot] = { hash, qint32(i) };
+                    break;
+                }
+            }
+        }
+    }
+}
+
+quint32 Database::itemIndexHash(uint itemTypeIndex, QByteArrayView id)
+{
+    return quint32(qHash(id, itemTypeIndex));
+}
+
+const Item *Database::findItem(uint itemTypeIndex, QByteArrayView id) const
+{
+    if (m_itemIndex.empty())
+        return nullptr;
+
+    const size_t mask = m_itemIndex.size() - 1;
+    const quint32 hash = itemIndexHash(itemTypeIndex, id);
+
+    for (size_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+        const ItemIndexSlot &s = m_itemIndex[slot];
+        if (s.itemIndex < 0)
+            return nullptr;
+        if (s.hash == hash) {
+            const Item &item = m_items[size_t(s.itemIndex)];
+            if ((item.m_itemTypeIndex == itemTypeIndex) && (QByteArrayView(item.id()) == id))
+                return &item;
+        }
+    }
+}
+
+QString Database::itemSearchText(const Item &item)
+{
+    QString str = QString::fromLatin1(item.id()) + u' ' + item.name();
+    if (item.hasAlternateIds())
+        str = str + u' ' + QString::fromLatin1(item.alternateIds());
+    return str;
+}
+
+static inline quint64 trigramAt(const QString &str, qsizetype pos)
+{
+    return (quint64(str.at(pos).unicode()) << 32) | (quint64(str.at(pos + 1).unicode()) << 16)
+            | quint64(str.at(pos + 2).unicode());
+}
+
+void Database::buildItemTrigramIndex() const
+{
+    stopwatch sw("Building the item search index");
+
+    m_itemTrigramIndex.clear();
+    for (size_t i = 0; i < m_items.size(); ++i) {
+        const QString str = itemSearchText(m_items[i]).toCaseFolded();
+
+        for (qsizetype pos = 0; pos < (str.size() - 2); ++pos) {
+            auto &itemIndexes = m_itemTrigramIndex[trigramAt(str, pos)];
+            if (itemIndexes.empty() || (itemIndexes.back() != quint32(i)))
+                itemIndexes.push_back(quint32(i));
+        }
+    }
+}
+
+QBitArray Database::itemTextCandidates(const QStringList &terms) const
+{
+    if (m_items.empty())
+        return { };
+    if (m_itemTrigramIndex.isEmpty())
+        buildItemTrigramIndex();
+
+    // every item containing all the terms has to show up in the posting lists of all their
+    // trigrams, so intersecting these lists, shortest first, gives a superset of the matches
+    std::vector<const std::vector<quint32> *> postings;
+    static const std::vector<quint32> noItems;
+
+    for (const QString &term : terms) {
+        const QString str = term.toCaseFolded();
+        for (qsizetype pos = 0; pos < (str.size() - 2); ++pos) {
+            auto it = m_itemTrigramIndex.constFind(trigramAt(str, pos));
+            postings.push_back((it != m_itemTrigramIndex.cend()) ? &it.value() : &noItems);
+        }
+    }
+    if (postings.empty()) // all terms are shorter than a trigram
+        return { };
+
+    std::sort(postings.begin(), postings.end(), [](const auto *p1, const auto *p2) {
+        return p1->size() < p2->size();
+    });
+
+    std::vector<quint32> candidates = *postings.front();
+    std::vector<quint32> intersection;
+    for (size_t i = 1; (i < postings.size()) && !candidates.empty(); ++i) {
+        if (postings[i] == postings[i - 1])
+            continue;
+        intersection.clear();
+        std::set_intersection(candidates.cbegin(), candidates.cend(),
+                              postings[i]->cbegin(), postings[i]->cend(),
+                              std::back_inserter(intersection));
+        std::swap(candidates, intersection);
+    }
+
+    QBitArray result(qsizetype(m_items.size()));
+    for (quint32 i : candidates)
+        result.setBit(qsizetype(i));
+    return result;
+}
+
+void Database::buildItemFacetIndex() const
+{
+    stopwatch sw("Building the item filter index");
+
+    m_itemsByItemType.assign(m_itemTypes.size(), { });
+    m_itemsByCategory.assign(m_categories.size(), { });
+    m_itemsByColor.assign(m_colors.size(), { });
+    m_itemsByYearReleased.clear();
+    m_itemsByYearLastProduced.clear();
+
+    for (size_t i = 0; i < m_items.size(); ++i) {
+        const Item &item = m_items[i];
+
+        if (item.m_itemTypeIndex < m_itemsByItemType.size())
+            m_itemsByItemType[item.m_itemTypeIndex].push_back(quint32(i));
+        for (const quint16 catIdx : item.m_categoryIndexes) {
+            if (catIdx < m_itemsByCategory.size())
+                m_itemsByCategory[catIdx].push_back(quint32(i));
+        }
+        for (const quint16 colIdx : item.m_knownColorIndexes) {
+            if (colIdx < m_itemsByColor.size())
+                m_itemsByColor[colIdx].push_back(quint32(i));
+        }
+        if (const int year = item.yearReleased())
+            m_itemsByYearReleased.emplace_back(year, quint32(i));
+        if (const int year = item.yearLastProduced())
+            m_itemsByYearLastProduced.emplace_back(year, quint32(i));
+    }
+    std::sort(m_itemsByYearReleased.begin(), m_itemsByYearReleased.end());
+    std::sort(m_itemsByYearLastProduced.begin(), m_itemsByYearLastProduced.end());
+}
+
+QBitArray Database::itemFacetCandidates(const ItemType *itemType, const Category *category,
+                                        const Color *color, int minYear, int maxYear) const
+{
+    if (m_items.empty() || (!itemType && !category && !color && !minYear && !maxYear))
+        return { };
+    if (m_itemsByItemType.empty())
+        buildItemFacetIndex();
+
+    const auto itemCount = qsizetype(m_items.size());
+    QBitArray result(itemCount, true);
+    QBitArray facet;
+
+    auto restrictTo = [&](auto begin, auto end, auto itemIndex) {
+        facet.fill(false, itemCount);
+        for (auto it = begin; it != end; ++it)
+            facet.setBit(qsizetype(itemIndex(*it)));
+        result &= facet;
+    };
+    auto restrictToList = [&](const auto &lists, const auto *which, const auto *first) {
+        // pointers outside of the database (e.g. LDraw-only colors) match no item at all
+        const auto index = which - first;
+        static const std::vector<quint32> noItems;
+        const auto &list = ((index >= 0) && (size_t(index) < lists.size())) ? lists[size_t(index)]
+                                                                            : noItems;
+        restrictTo(list.cbegin(), list.cend(), [](quint32 i) { return i; });
+    };
+
+    if (itemType)
+        restrictToList(m_itemsByItemType, itemType, m_itemTypes.data());
+    if (category)
+        restrictToList(m_itemsByCategory, category, m_categories.data());
+    if (color)
+        restrictToList(m_itemsByColor, color, m_colors.data());
+    if (minYear) {
+        auto it = std::lower_bound(m_itemsByYearReleased.cbegin(), m_itemsByYearReleased.cend(),
+                                   std::make_pair(minYear, quint32(0)));
+        restrictTo(it, m_itemsByYearReleased.cend(), [](const auto &p) { return p.second; });
+    }
+    if (maxYear) {
+        auto it = std::lower_bound(m_itemsByYearLastProduced.cbegin(), m_itemsByYearLastProduced.cend(),
+                                   std::make_pair(maxYear + 1, quint32(0)));
+        restrictTo(m_itemsByYearLastProduced.cbegin(), it, [](const auto &p) { return p.second; });
+    }
+    return result;
+}
+
 void Database::remove()
 {
     QString dbDir = core()->dataPath();
@@ -902,6 +1558,441 @@ void Database::writeApiKeyToDatabase(const QByteArray &id, const QString &key, Q
     dataStream << idScrambled << keyScrambled;
 }
 
+
+///////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////
+
+
+/* Starting with V13, the bulk chunks are stored as memory-mappable record tables:
+ *   a small header of quint32s, followed by fixed-size records, followed by a blob.
+ * The blob contains all PooledArrays verbatim in their in-memory layout, each one aligned to
+ * 8 bytes. Records reference these arrays via their offset from the start of the chunk data
+ * (0 means empty), so loading only has to point the arrays into the mapped file.
+ * Chunk data always starts on a 16 byte boundary, so the alignment carries over to the mapping.
+ */
+
+namespace {
+
+constexpr qsizetype TableAlignment = 8;
+
+struct ColorRecord
+{
+    quint32 id;
+    quint32 name;
+    qint32  ldrawId;
+    quint32 type;
+    QRgb    color;
+    QRgb    ldrawColor;
+    QRgb    ldrawEdgeColor;
+    QRgb    particleColor;
+    quint32 validColors; // bit mask for the 4 QRgb values above
+    float   popularity;
+    quint16 yearFrom;
+    quint16 yearTo;
+    float   luminance;
+    float   particleMinSize;
+    float   particleMaxSize;
+    float   particleFraction;
+    float   particleVFraction;
+    quint32 reserved;
+};
+
+struct CategoryRecord
+{
+    quint32 id;
+    quint32 name;
+    quint8  yearFrom;
+    quint8  yearTo;
+    quint8  yearRecency;
+    quint8  hasInventories;
+    quint32 reserved;
+};
+
+struct ItemRecord
+{
+    quint32 id;
+    quint32 name;
+    quint32 categoryIndexes;
+    quint32 knownColorIndexes;
+    quint32 appearsIn;
+    quint32 consistsOf;
+    quint32 relationshipMatchIds;
+    quint32 dimensions;
+    quint32 pccs;
+    quint32 alternateIds;
+    quint16 itemTypeIndex;
+    quint16 defaultColorIndex;
+    quint8  yearFrom;
+    quint8  yearTo;
+    quint16 reserved1;
+    float   weight;
+    quint32 reserved2;
+};
+
+struct ItemChangeLogRecord
+{
+    quint32 id;
+    quint32 julianDay;
+    quint32 fromTypeAndId;
+    quint32 toTypeAndId;
+};
+
+struct ColorChangeLogRecord
+{
+    quint32 id;
+    quint32 julianDay;
+    quint32 fromColorId;
+    quint32 toColorId;
+};
+
+static_assert(sizeof(ColorRecord) % TableAlignment == 0);
+static_assert(sizeof(CategoryRecord) % TableAlignment == 0);
+static_assert(sizeof(ItemRecord) % TableAlignment == 0);
+static_assert(sizeof(ItemChangeLogRecord) % TableAlignment == 0);
+static_assert(sizeof(ColorChangeLogRecord) % TableAlignment == 0);
+
+// the records and arrays are stored in host order
+static_assert(Q_BYTE_ORDER == Q_LITTLE_ENDIAN, "V13 database tables require a little-endian host");
+
+class TableWriter
+{
+public:
+    TableWriter(qsizetype headerSize, qsizetype recordsSize)
+        : m_blobStart(headerSize + recordsSize)
+    {
+        Q_ASSERT(m_blobStart % TableAlignment == 0);
+    }
+
+    template<typename T> quint32 add(const PooledArray<T> &pa)
+    {
+        static_assert(PooledArray<T>::rawDataAlignment() <= TableAlignment);
+
+        if (pa.isEmpty())
+            return 0;
+        const qsizetype offset = m_blobStart + m_blob.size();
+        if (offset > qsizetype(std::numeric_limits<quint32>::max()))
+            throw Exception("database table exceeds the maximum size");
+        m_blob.append(static_cast<const char *>(pa.rawData()), pa.rawDataSize());
+        if (const auto pad = m_blob.size() % TableAlignment)
+            m_blob.append(TableAlignment - pad, '\0');
+        return quint32(offset);
+    }
+
+    template<typename R> static void writeRecords(QDataStream &ds, const std::vector<R> &records)
+    {
+        ds.writeRawData(reinterpret_cast<const char *>(records.data()),
+                        int(records.size() * sizeof(R)));
+    }
+
+    void writeBlob(QDataStream &ds) const
+    {
+        ds.writeRawData(m_blob.constData(), int(m_blob.size()));
+    }
+
+private:
+    qsizetype m_blobStart;
+    QByteArray m_blob;
+};
+
+class TableReader
+{
+public:
+    explicit TableReader(QByteArrayView chunk)
+        : m_chunk(chunk)
+    {
+        if (quintptr(m_chunk.data()) % TableAlignment)
+            throw Exception("database table is not correctly aligned");
+    }
+
+    quint32 header(qsizetype index) const
+    {
+        if (qsizetype(index + 1) * qsizetype(sizeof(quint32)) > m_chunk.size())
+            throw Exception("database table header is truncated");
+        return qFromLittleEndian<quint32>(m_chunk.data() + index * qsizetype(sizeof(quint32)));
+    }
+
+    template<typename R> std::span<const R> records(qsizetype offset, quint32 count, quint32 max) const
+    {
+        if (count > max) {
+            throw Exception("database table size %L1 is larger than expected maximum %L2")
+                .arg(count).arg(max);
+        }
+        if ((offset % TableAlignment) || ((offset + qsizetype(count) * qsizetype(sizeof(R))) > m_chunk.size()))
+            throw Exception("database table records are out of bounds");
+        return { reinterpret_cast<const R *>(m_chunk.data() + offset), count };
+    }
+
+    template<typename T> void attach(PooledArray<T> &pa, quint32 offset) const
+    {
+        if (!offset)
+            return;
+        if ((offset % TableAlignment) || ((qsizetype(offset) + qsizetype(sizeof(T))) > m_chunk.size()))
+            throw Exception("database table array is out of bounds");
+        pa.fromRawData(m_chunk.data() + offset);
+        if ((pa.size() <= 0) || ((qsizetype(offset) + pa.rawDataSize()) > m_chunk.size()))
+            throw Exception("database table array is corrupt");
+    }
+
+private:
+    QByteArrayView m_chunk;
+};
+
+constexpr qsizetype TableHeaderSize = 2 * sizeof(quint32); // count, reserved
+
+} // namespace
+
+
+void Database::readColorTableFromDatabase(std::vector<Color> &colors, QByteArrayView chunk)
+{
+    const TableReader tr(chunk);
+    const auto records = tr.records<ColorRecord>(TableHeaderSize, tr.header(0), 1'000);
+
+    auto toColor = [](QRgb rgba, bool valid) {
+        return valid ? QColor::fromRgba(rgba) : QColor { };
+    };
+
+    colors.resize(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        const ColorRecord &r = records[i];
+        Color &col = colors[i];
+
+        col.m_id = r.id;
+        tr.attach(col.m_name, r.name);
+        col.m_ldraw_id = r.ldrawId;
+        col.m_type = static_cast<ColorType>(r.type);
+        col.m_color = toColor(r.color, r.validColors & 0x01);
+        col.m_ldraw_color = toColor(r.ldrawColor, r.validColors & 0x02);
+        col.m_ldraw_edge_color = toColor(r.ldrawEdgeColor, r.validColors & 0x04);
+        col.m_particleColor = toColor(r.particleColor, r.validColors & 0x08);
+        col.m_popularity = r.popularity;
+        col.m_year_from = r.yearFrom;
+        col.m_year_to = r.yearTo;
+        col.m_luminance = r.luminance;
+        col.m_particleMinSize = r.particleMinSize;
+        col.m_particleMaxSize = r.particleMaxSize;
+        col.m_particleFraction = r.particleFraction;
+        col.m_particleVFraction = r.particleVFraction;
+    }
+}
+
+void Database::writeColorTableToDatabase(const std::vector<Color> &colors, QDataStream &dataStream) const
+{
+    std::vector<ColorRecord> records(colors.size());
+    TableWriter tw(TableHeaderSize, qsizetype(records.size() * sizeof(ColorRecord)));
+
+    for (size_t i = 0; i < colors.size(); ++i) {
+        const Color &col = colors[i];
+        ColorRecord &r = records[i];
+
+        r.id = col.m_id;
+        r.name = tw.add(col.m_name);
+        r.ldrawId = col.m_ldraw_id;
+        r.type = quint32(col.m_type);
+        r.color = col.m_color.rgba();
+        r.ldrawColor = col.m_ldraw_color.rgba();
+        r.ldrawEdgeColor = col.m_ldraw_edge_color.rgba();
+        r.particleColor = col.m_particleColor.rgba();
+        r.validColors = (col.m_color.isValid()            ? 0x01 : 0)
+                        | (col.m_ldraw_color.isValid()      ? 0x02 : 0)
+                        | (col.m_ldraw_edge_color.isValid() ? 0x04 : 0)
+                        | (col.m_particleColor.isValid()    ? 0x08 : 0);
+        r.popularity = col.m_popularity;
+        r.yearFrom = col.m_year_from;
+        r.yearTo = col.m_year_to;
+        r.luminance = col.m_luminance;
+        r.particleMinSize = col.m_particleMinSize;
+        r.particleMaxSize = col.m_particleMaxSize;
+        r.particleFraction = col.m_particleFraction;
+        r.particleVFraction = col.m_particleVFraction;
+        r.reserved = 0;
+    }
+
+    dataStream << quint32(records.size()) << quint32(0);
+    tw.writeRecords(dataStream, records);
+    tw.writeBlob(dataStream);
+}
+
+void Database::readCategoryTableFromDatabase(std::vector<Category> &categories, QByteArrayView chunk)
+{
+    const TableReader tr(chunk);
+    const auto records = tr.records<CategoryRecord>(TableHeaderSize, tr.header(0), 10'000);
+
+    categories.resize(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        const CategoryRecord &r = records[i];
+        Category &cat = categories[i];
+
+        cat.m_id = r.id;
+        tr.attach(cat.m_name, r.name);
+        cat.m_year_from = r.yearFrom;
+        cat.m_year_to = r.yearTo;
+        cat.m_year_recency = r.yearRecency;
+        cat.m_has_inventories = r.hasInventories;
+    }
+}
+
+void Database::writeCategoryTableToDatabase(const std::vector<Category> &categories, QDataStream &dataStream) const
+{
+    std::vector<CategoryRecord> records(categories.size());
+    TableWriter tw(TableHeaderSize, qsizetype(records.size() * sizeof(CategoryRecord)));
+
+    for (size_t i = 0; i < categories.size(); ++i) {
+        const Category &cat = categories[i];
+        CategoryRecord &r = records[i];
+
+        r.id = cat.m_id;
+        r.name = tw.add(cat.m_name);
+        r.yearFrom = cat.m_year_from;
+        r.yearTo = cat.m_year_to;
+        r.yearRecency = cat.m_year_recency;
+        r.hasInventories = cat.m_has_inventories;
+        r.reserved = 0;
+    }
+
+    dataStream << quint32(records.size()) << quint32(0);
+    tw.writeRecords(dataStream, records);
+    tw.writeBlob(dataStream);
+}
+
+qsizetype Database::readItemTableSizeFromDatabase(QByteArrayView chunk)
+{
+    const TableReader tr(chunk);
+    return qsizetype(tr.records<ItemRecord>(TableHeaderSize, tr.header(0), 1'000'000).size());
+}
+
+// Fills the already allocated items [from, to), so multiple ranges can be read in parallel
+void Database::readItemTableFromDatabase(std::vector<Item> &items, QByteArrayView chunk,
+                                         qsizetype from, qsizetype to)
+{
+    const TableReader tr(chunk);
+    const auto records = tr.records<ItemRecord>(TableHeaderSize, tr.header(0), 1'000'000);
+
+    Q_ASSERT(items.size() == records.size());
+    Q_ASSERT((from >= 0) && (from <= to) && (to <= qsizetype(records.size())));
+
+    for (auto i = size_t(from); i < size_t(to); ++i) {
+        const ItemRecord &r = records[i];
+        Item &item = items[i];
+
+        tr.attach(item.m_id, r.id);
+        tr.attach(item.m_name, r.name);
+        tr.attach(item.m_categoryIndexes, r.categoryIndexes);
+        tr.attach(item.m_knownColorIndexes, r.knownColorIndexes);
+        tr.attach(item.m_appears_in, r.appearsIn);
+        tr.attach(item.m_consists_of, r.consistsOf);
+        tr.attach(item.m_relationshipMatchIds, r.relationshipMatchIds);
+        tr.attach(item.m_dimensions, r.dimensions);
+        tr.attach(item.m_pccs, r.pccs);
+        tr.attach(item.m_alternateIds, r.alternateIds);
+        item.m_itemTypeIndex = r.itemTypeIndex;
+        item.m_defaultColorIndex = r.defaultColorIndex;
+        item.m_year_from = r.yearFrom;
+        item.m_year_to = r.yearTo;
+        item.m_weight = r.weight;
+    }
+}
+
+void Database::writeItemTableToDatabase(const std::vector<Item> &items, QDataStream &dataStream) const
+{
+    std::vector<ItemRecord> records(items.size());
+    TableWriter tw(TableHeaderSize, qsizetype(records.size() * sizeof(ItemRecord)));
+
+    for (size_t i = 0; i < items.size(); ++i) {
+        const Item &item = items[i];
+        ItemRecord &r = records[i];
+
+        r.id = tw.add(item.m_id);
+        r.name = tw.add(item.m_name);
+        r.categoryIndexes = tw.add(item.m_categoryIndexes);
+        r.knownColorIndexes = tw.add(item.m_knownColorIndexes);
+        r.appearsIn = tw.add(item.m_appears_in);
+        r.consistsOf = tw.add(item.m_consists_of);
+        r.relationshipMatchIds = tw.add(item.m_relationshipMatchIds);
+        r.dimensions = tw.add(item.m_dimensions);
+        r.pccs = tw.add(item.m_pccs);
+        r.alternateIds = tw.add(item.m_alternateIds);
+        r.itemTypeIndex = item.m_itemTypeIndex;
+        r.defaultColorIndex = item.m_defaultColorIndex;
+        r.yearFrom = item.m_year_from;
+        r.yearTo = item.m_year_to;
+        r.reserved1 = 0;
+        r.weight = item.m_weight;
+        r.reserved2 = 0;
+    }
+
+    dataStream << quint32(records.size()) << quint32(0);
+    tw.writeRecords(dataStream, records);
+    tw.writeBlob(dataStream);
+}
+
+uint Database::readChangeLogTableFromDatabase(std::vector<ItemChangeLogEntry> &itemChangelog,
+                                              std::vector<ColorChangeLogEntry> &colorChangelog,
+                                              QByteArrayView chunk)
+{
+    // header: latest id, item count, color count, reserved
+    const TableReader tr(chunk);
+    const quint32 latestId = tr.header(0);
+    const auto itemRecords = tr.records<ItemChangeLogRecord>(4 * sizeof(quint32), tr.header(1), 1'000'000);
+    const auto colorRecords = tr.records<ColorChangeLogRecord>(4 * sizeof(quint32) + itemRecords.size_bytes(),
+                                                               tr.header(2), 1'000);
+
+    itemChangelog.resize(itemRecords.size());
+    for (size_t i = 0; i < itemRecords.size(); ++i) {
+        const ItemChangeLogRecord &r = itemRecords[i];
+        ItemChangeLogEntry &e = itemChangelog[i];
+
+        e.m_id = r.id;
+        e.m_julianDay = r.julianDay;
+        tr.attach(e.m_fromTypeAndId, r.fromTypeAndId);
+        tr.attach(e.m_toTypeAndId, r.toTypeAndId);
+    }
+    colorChangelog.resize(colorRecords.size());
+    for (size_t i = 0; i < colorRecords.size(); ++i) {
+        const ColorChangeLogRecord &r = colorRecords[i];
+        ColorChangeLogEntry &e = colorChangelog[i];
+
+        e.m_id = r.id;
+        e.m_julianDay = r.julianDay;
+        e.m_fromColorId = r.fromColorId;
+        e.m_toColorId = r.toColorId;
+    }
+    return latestId;
+}
+
+void Database::writeChangeLogTableToDatabase(QDataStream &dataStream) const
+{
+    std::vector<ItemChangeLogRecord> itemRecords(m_itemChangelog.size());
+    std::vector<ColorChangeLogRecord> colorRecords(m_colorChangelog.size());
+    TableWriter tw(4 * sizeof(quint32), qsizetype(itemRecords.size() * sizeof(ItemChangeLogRecord)
+                                                 + colorRecords.size() * sizeof(ColorChangeLogRecord)));
+
+    for (size_t i = 0; i < m_itemChangelog.size(); ++i) {
+        const ItemChangeLogEntry &e = m_itemChangelog[i];
+        ItemChangeLogRecord &r = itemRecords[i];
+
+        r.id = e.m_id;
+        r.julianDay = e.m_julianDay;
+        r.fromTypeAndId = tw.add(e.m_fromTypeAndId);
+        r.toTypeAndId = tw.add(e.m_toTypeAndId);
+    }
+    for (size_t i = 0; i < m_colorChangelog.size(); ++i) {
+        const ColorChangeLogEntry &e = m_colorChangelog[i];
+        ColorChangeLogRecord &r = colorRecords[i];
+
+        r.id = e.m_id;
+        r.julianDay = e.m_julianDay;
+        r.fromColorId = e.m_fromColorId;
+        r.toColorId = e.m_toColorId;
+    }
+
+    dataStream << quint32(m_latestChangelogId) << quint32(itemRecords.size())
+               << quint32(colorRecords.size()) << quint32(0);
+    tw.writeRecords(dataStream, itemRecords);
+    tw.writeRecords(dataStream, colorRecords);
+    tw.writeBlob(dataStream);
+}
+
 } // namespace BrickLink
 
 //#include "moc_database.cpp" // QTBUG-98845
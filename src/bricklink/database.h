@@ -5,6 +5,7 @@
 
 #include <QObject>
 #include <QDateTime>
+#include <QBitArray>
 #include <QtQml/qqmlregistration.h>
 
 #include "bricklink/global.h"
@@ -18,6 +19,8 @@
 #include "utility/memoryresource.h"
 
 
+QT_FORWARD_DECLARE_CLASS(QFile)
+
 class Transfer;
 class TransferJob;
 
@@ -49,10 +52,11 @@ public:
         V10, // 2023.11.1
         V11, // 2024.1.2
         V12, // 2024.3.1
+        V13, // 2025.2.1
 
         OldestStillSupported = V6,
 
-        Latest = V12
+        Latest = V13
     };
 
     void setUpdateInterval(int interval);
@@ -72,8 +76,17 @@ public:
     void read(const QString &fileName = { });
     void write(const QString &fileName, Version version) const;
 
+    // chunk-level deltas between two database files: both throw Exceptions on error.
+    // applyDelta() returns an empty array if base already is the delta's target.
+    // An empty base to createDelta() results in a delta that only says "full download needed".
+    static QByteArray createDelta(const QByteArray &base, const QByteArray &target);
+    static QByteArray applyDelta(const QByteArray &base, const QByteArray &delta);
+
     static void remove();
 
+    // the text that the item browser's filter is matched against
+    static QString itemSearchText(const Item &item);
+
 signals:
     void updateStarted();
     void updateProgress(int received, int total);
@@ -87,9 +100,25 @@ signals:
 private:
     Database(const QString &updateUrl, QObject *parent = nullptr);
     void setUpdateStatus(UpdateStatus updateStatus);
+    QString remoteUrl(const QString &fileName) const;
+    bool startDownload(bool delta, bool force);
+    bool finishDeltaUpdate(TransferJob *job, bool validChecksum, const QByteArray &delta);
     QString dumpDatabaseInformation(const QString &title, bool itemTypeInfo, bool apiQuirksInfo) const;
 
     void clear();
+    void buildIndexes();
+
+    // LDraw "direct colors" (0x2RRGGBB) are never part of the database
+    static constexpr int MaxIndexedLDrawColorId = 0x10000;
+
+    static quint32 itemIndexHash(uint itemTypeIndex, QByteArrayView id);
+    const Item *findItem(uint itemTypeIndex, QByteArrayView id) const;
+
+    void buildItemTrigramIndex() const;
+    QBitArray itemTextCandidates(const QStringList &terms) const;
+    void buildItemFacetIndex() const;
+    QBitArray itemFacetCandidates(const ItemType *itemType, const Category *category,
+                                  const Color *color, int minYear, int maxYear) const;
 
     QString m_updateUrl;
     bool m_valid = false;
@@ -97,10 +126,13 @@ private:
     int m_updateInterval = 0;
     QDateTime m_lastUpdated;
     QString m_etag;
+    QString m_deltaEtag;
     Transfer *m_transfer;
     TransferJob *m_job = nullptr;
 
-    std::unique_ptr<MemoryResource>  m_pool;
+    std::vector<std::unique_ptr<MemoryResource>> m_pools;
+    std::unique_ptr<QFile>           m_mappedFile; // V13+ records point into this mapping
+    std::unique_ptr<char[]>          m_fileData;   // ... or into this copy, if we cannot map
     std::vector<Color>               m_colors;
     std::vector<Color>               m_ldrawExtraColors;
     std::vector<Category>            m_categories;
@@ -110,6 +142,24 @@ private:
     std::vector<ColorChangeLogEntry> m_colorChangelog;
     std::vector<Relationship>        m_relationships;
     std::vector<RelationshipMatch>   m_relationshipMatches;
+    std::vector<PartColorCode>       m_pccIndex; // derived from m_items, sorted by PCC
+    QHash<QString, const Color *>    m_colorNameIndex; // case-folded names of m_colors
+    std::vector<const Color *>       m_ldrawColorIndex; // LDraw id -> m_colors or m_ldrawExtraColors
+
+    struct ItemIndexSlot {
+        quint32 hash;
+        qint32  itemIndex; // -1 if unused
+    };
+    std::vector<ItemIndexSlot>       m_itemIndex; // open addressing hash: (item type, id) -> m_items
+    // case-folded trigram -> sorted m_items indexes, built on the first text search
+    mutable QHash<quint64, std::vector<quint32>> m_itemTrigramIndex;
+    // sorted m_items indexes per item type, category and known color, built on the first
+    // filter change, plus (year, m_items index) pairs sorted by year
+    mutable std::vector<std::vector<quint32>> m_itemsByItemType;
+    mutable std::vector<std::vector<quint32>> m_itemsByCategory;
+    mutable std::vector<std::vector<quint32>> m_itemsByColor;
+    mutable std::vector<std::pair<int, quint32>> m_itemsByYearReleased;
+    mutable std::vector<std::pair<int, quint32>> m_itemsByYearLastProduced;
     QHash<QByteArray, QString>       m_apiKeys;
     QSet<ApiQuirk>                   m_apiQuirks;
 
@@ -137,6 +187,18 @@ private:
     void writeRelationshipToDatabase(const Relationship &e, QDataStream &dataStream, Version v) const;
     static void readRelationshipMatchFromDatabase(RelationshipMatch &e, QDataStream &dataStream, MemoryResource *pool);
     void writeRelationshipMatchToDatabase(const RelationshipMatch &e, QDataStream &dataStream, Version v) const;
+    static void readColorTableFromDatabase(std::vector<Color> &colors, QByteArrayView chunk);
+    void writeColorTableToDatabase(const std::vector<Color> &colors, QDataStream &dataStream) const;
+    static void readCategoryTableFromDatabase(std::vector<Category> &categories, QByteArrayView chunk);
+    void writeCategoryTableToDatabase(const std::vector<Category> &categories, QDataStream &dataStream) const;
+    static qsizetype readItemTableSizeFromDatabase(QByteArrayView chunk);
+    static void readItemTableFromDatabase(std::vector<Item> &items, QByteArrayView chunk,
+                                          qsizetype from, qsizetype to);
+    void writeItemTableToDatabase(const std::vector<Item> &items, QDataStream &dataStream) const;
+    static uint readChangeLogTableFromDatabase(std::vector<ItemChangeLogEntry> &itemChangelog,
+                                               std::vector<ColorChangeLogEntry> &colorChangelog,
+                                               QByteArrayView chunk);
+    void writeChangeLogTableToDatabase(QDataStream &dataStream) const;
     static void readApiKeyFromDatabase(QByteArray &id, QString &key, QDataStream &dataStream, MemoryResource *pool);
     void writeApiKeyToDatabase(const QByteArray &id, const QString &key, QDataStream &dataStream, Version v) const;
 
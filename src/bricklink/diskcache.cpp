@@ -0,0 +1,117 @@
+// Copyright (C) 2004-2025 Robert Griebl
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+
+#include <QtCore/QStringBuilder>
+#include <QtCore/QLoggingCategory>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlQuery>
+
+#include "bricklink/diskcache.h"
+
+Q_DECLARE_LOGGING_CATEGORY(LogSql)
+
+
+namespace BrickLink {
+
+// don't lock the database for too long: the loaders would stall
+static constexpr qint64 MaxEvictBatchSize = 1000;
+
+
+static qint64 pragmaValue(QSqlDatabase &db, const QString &pragma)
+{
+    QSqlQuery query(u"PRAGMA " % pragma % u';', db);
+    return query.next() ? query.value(0).toLongLong() : -1;
+}
+
+void DiskCache::enableIncrementalVacuum(QSqlDatabase &db)
+{
+    QSqlQuery query(u"PRAGMA auto_vacuum = incremental;"_qs, db);
+    if (query.lastError().isValid())
+        qCWarning(LogSql) << "Failed to enable incremental vacuum on" << db.databaseName() << ":"
+                          << query.lastError().text();
+}
+
+qint64 DiskCache::usedSize(QSqlDatabase &db)
+{
+    const qint64 pageCount = pragmaValue(db, u"page_count"_qs);
+    const qint64 freeCount = pragmaValue(db, u"freelist_count"_qs);
+    const qint64 pageSize = pragmaValue(db, u"page_size"_qs);
+
+    if ((pageCount < 0) || (freeCount < 0) || (pageSize <= 0))
+        return -1;
+    return (pageCount - freeCount) * pageSize;
+}
+
+qint64 DiskCache::compact(QSqlDatabase &db, const QString &table, qint64 maxSize)
+{
+    qint64 size = usedSize(db);
+    if ((maxSize <= 0) || (size <= maxSize))
+        return size;
+
+    // evict down to 90% of the budget, so that the next few saves don't trigger another run
+    const qint64 targetSize = maxSize / 10 * 9;
+
+    qint64 rowCount = 0;
+    {
+        QSqlQuery countQuery(u"SELECT COUNT(*) FROM " % table % u';', db);
+        if (countQuery.next())
+            rowCount = countQuery.value(0).toLongLong();
+    }
+
+    QSqlQuery evictQuery(db);
+    evictQuery.prepare(u"DELETE FROM " % table % u" WHERE id IN (SELECT id FROM " % table
+                       % u" ORDER BY accessed LIMIT ?);");
+
+    qint64 evicted = 0;
+
+    while ((size > targetSize) && (rowCount > 0)) {
+        // guess the number of rows to remove from the average row size
+        const qint64 avgRowSize = std::max<qint64>(1, size / rowCount);
+        const qint64 batchSize = std::clamp<qint64>((size - targetSize) / avgRowSize + 1,
+                                                    1, MaxEvictBatchSize);
+
+        db.transaction();
+        evictQuery.bindValue(0, batchSize);
+        const bool ok = evictQuery.exec();
+        const int removed = ok ? evictQuery.numRowsAffected() : 0;
+        if (!ok) {
+            qCWarning(LogSql) << "Failed to evict entries from the" << table << "cache:"
+                              << evictQuery.lastError().text();
+        }
+        evictQuery.finish();
+        db.commit();
+
+        if (removed <= 0)
+            break;
+        rowCount -= removed;
+        evicted += removed;
+        size = usedSize(db);
+    }
+
+    if (evicted) {
+        if (pragmaValue(db, u"auto_vacuum"_qs) == 2) {
+            // every step of this pragma only frees a single page
+            QSqlQuery vacuumQuery(u"PRAGMA incremental_vacuum;"_qs, db);
+            while (vacuumQuery.next())
+                ;
+        } else {
+            // databases created before the size limit existed need a one-time full vacuum
+            enableIncrementalVacuum(db);
+            QSqlQuery vacuumQuery(u"VACUUM;"_qs, db);
+            if (vacuumQuery.lastError().isValid())
+                qCWarning(LogSql) << "Failed to vacuum the" << table << "cache:"
+                                  << vacuumQuery.lastError().text();
+        }
+        // shrink the WAL file as well
+        QSqlQuery(u"PRAGMA wal_checkpoint(TRUNCATE);"_qs, db);
+
+        qCInfo(LogSql).noquote() << "Evicted" << evicted << "entries from the" << table << "cache, now using"
+                                 << QByteArray::number(double(size) / 1'000'000, 'f', 1) << "MB";
+    }
+    return size;
+}
+
+} // namespace BrickLink
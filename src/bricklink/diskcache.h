@@ -0,0 +1,31 @@
+// Copyright (C) 2004-2025 Robert Griebl
+// SPDX-License-Identifier: GPL-3.0-only
+
+#pragma once
+
+#include <QtCore/QString>
+
+QT_FORWARD_DECLARE_CLASS(QSqlDatabase)
+
+
+namespace BrickLink {
+
+// Helpers shared by the SQLite based picture and price-guide caches. Both use a table with
+// (at least) an 'id' primary key and an 'accessed' timestamp column.
+
+namespace DiskCache {
+
+// Has to be called on a new database before the first table is created
+void enableIncrementalVacuum(QSqlDatabase &db);
+
+// The number of bytes used by the database contents (pages on the free-list are not counted)
+qint64 usedSize(QSqlDatabase &db);
+
+// Evicts the least recently accessed rows from \a table until at most \a maxSize bytes are used
+// and returns the freed pages to the file system afterwards. Returns the new used size.
+// A \a maxSize of 0 means unlimited.
+qint64 compact(QSqlDatabase &db, const QString &table, qint64 maxSize);
+
+} // namespace DiskCache
+
+} // namespace BrickLink
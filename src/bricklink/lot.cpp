@@ -131,6 +131,144 @@ void Lot::save(QDataStream &ds) const
        << m_dateAdded << m_dateLastSold;
 }
 
+Lot::DeltaFields Lot::differingFields(const Lot &other) const
+{
+    DeltaFields fields = 0;
+    auto check = [&fields](DeltaField field, bool differs) {
+        if (differs)
+            fields |= (1u << uint(field));
+    };
+
+    check(DeltaField::Identity,      (m_item != other.m_item) || (m_color != other.m_color)
+                                     || (bool(m_incomplete) != bool(other.m_incomplete))
+                                     || (m_incomplete && (*m_incomplete != *other.m_incomplete)));
+    check(DeltaField::Status,        m_status != other.m_status);
+    check(DeltaField::Condition,     m_condition != other.m_condition);
+    check(DeltaField::SubCondition,  m_scondition != other.m_scondition);
+    check(DeltaField::Retain,        m_retain != other.m_retain);
+    check(DeltaField::Stockroom,     m_stockroom != other.m_stockroom);
+    check(DeltaField::Alternate,     m_alternate != other.m_alternate);
+    check(DeltaField::AlternateId,   m_alt_id != other.m_alt_id);
+    check(DeltaField::CounterPart,   m_cpart != other.m_cpart);
+    check(DeltaField::LotId,         m_lot_id != other.m_lot_id);
+    check(DeltaField::Reserved,      m_reserved != other.m_reserved);
+    check(DeltaField::Comments,      m_comments != other.m_comments);
+    check(DeltaField::Remarks,       m_remarks != other.m_remarks);
+    check(DeltaField::Quantity,      m_quantity != other.m_quantity);
+    check(DeltaField::BulkQuantity,  m_bulk_quantity != other.m_bulk_quantity);
+    check(DeltaField::TierQuantity0, m_tier_quantity[0] != other.m_tier_quantity[0]);
+    check(DeltaField::TierQuantity1, m_tier_quantity[1] != other.m_tier_quantity[1]);
+    check(DeltaField::TierQuantity2, m_tier_quantity[2] != other.m_tier_quantity[2]);
+    check(DeltaField::Sale,          m_sale != other.m_sale);
+    // undo has to restore the exact values, so no fuzzy compares here
+    check(DeltaField::Price,         m_price != other.m_price);
+    check(DeltaField::Cost,          m_cost != other.m_cost);
+    check(DeltaField::TierPrice0,    m_tier_price[0] != other.m_tier_price[0]);
+    check(DeltaField::TierPrice1,    m_tier_price[1] != other.m_tier_price[1]);
+    check(DeltaField::TierPrice2,    m_tier_price[2] != other.m_tier_price[2]);
+    check(DeltaField::Weight,        m_weight != other.m_weight);
+    check(DeltaField::MarkerText,    m_markerText != other.m_markerText);
+    check(DeltaField::MarkerColor,   m_markerColor != other.m_markerColor);
+    check(DeltaField::DateAdded,     m_dateAdded != other.m_dateAdded);
+    check(DeltaField::DateLastSold,  m_dateLastSold != other.m_dateLastSold);
+    return fields;
+}
+
+void Lot::saveFields(QDataStream &ds, DeltaFields fields) const
+{
+    auto has = [fields](DeltaField field) { return fields & (1u << uint(field)); };
+
+    // the item and color pointers are only valid within this process, but so is the undo stack
+    if (has(DeltaField::Identity)) {
+        ds << quintptr(m_item) << quintptr(m_color) << bool(m_incomplete);
+        if (m_incomplete) {
+            ds << m_incomplete->m_item_id << m_incomplete->m_itemtype_id
+               << m_incomplete->m_category_id << m_incomplete->m_color_id
+               << m_incomplete->m_item_name << m_incomplete->m_itemtype_name
+               << m_incomplete->m_category_name << m_incomplete->m_color_name;
+        }
+    }
+    if (has(DeltaField::Status))        ds << qint8(m_status);
+    if (has(DeltaField::Condition))     ds << qint8(m_condition);
+    if (has(DeltaField::SubCondition))  ds << qint8(m_scondition);
+    if (has(DeltaField::Retain))        ds << bool(m_retain);
+    if (has(DeltaField::Stockroom))     ds << qint8(m_stockroom);
+    if (has(DeltaField::Alternate))     ds << bool(m_alternate);
+    if (has(DeltaField::AlternateId))   ds << quint8(m_alt_id);
+    if (has(DeltaField::CounterPart))   ds << bool(m_cpart);
+    if (has(DeltaField::LotId))         ds << m_lot_id;
+    if (has(DeltaField::Reserved))      ds << m_reserved;
+    if (has(DeltaField::Comments))      ds << m_comments;
+    if (has(DeltaField::Remarks))       ds << m_remarks;
+    if (has(DeltaField::Quantity))      ds << m_quantity;
+    if (has(DeltaField::BulkQuantity))  ds << m_bulk_quantity;
+    if (has(DeltaField::TierQuantity0)) ds << m_tier_quantity[0];
+    if (has(DeltaField::TierQuantity1)) ds << m_tier_quantity[1];
+    if (has(DeltaField::TierQuantity2)) ds << m_tier_quantity[2];
+    if (has(DeltaField::Sale))          ds << m_sale;
+    if (has(DeltaField::Price))         ds << m_price;
+    if (has(DeltaField::Cost))          ds << m_cost;
+    if (has(DeltaField::TierPrice0))    ds << m_tier_price[0];
+    if (has(DeltaField::TierPrice1))    ds << m_tier_price[1];
+    if (has(DeltaField::TierPrice2))    ds << m_tier_price[2];
+    if (has(DeltaField::Weight))        ds << m_weight;
+    if (has(DeltaField::MarkerText))    ds << m_markerText;
+    if (has(DeltaField::MarkerColor))   ds << m_markerColor;
+    if (has(DeltaField::DateAdded))     ds << m_dateAdded;
+    if (has(DeltaField::DateLastSold))  ds << m_dateLastSold;
+}
+
+void Lot::loadFields(QDataStream &ds, DeltaFields fields)
+{
+    auto has = [fields](DeltaField field) { return fields & (1u << uint(field)); };
+    qint8 i8;
+    quint8 u8;
+    bool b;
+
+    if (has(DeltaField::Identity)) {
+        quintptr item, color;
+        ds >> item >> color >> b;
+        m_item = reinterpret_cast<const Item *>(item);
+        m_color = reinterpret_cast<const Color *>(color);
+        if (b) {
+            auto inc = std::make_unique<Incomplete>();
+            ds >> inc->m_item_id >> inc->m_itemtype_id >> inc->m_category_id >> inc->m_color_id
+               >> inc->m_item_name >> inc->m_itemtype_name >> inc->m_category_name >> inc->m_color_name;
+            m_incomplete = std::move(inc);
+        } else {
+            m_incomplete.reset();
+        }
+    }
+    if (has(DeltaField::Status))        { ds >> i8; m_status = Status(i8); }
+    if (has(DeltaField::Condition))     { ds >> i8; m_condition = Condition(i8); }
+    if (has(DeltaField::SubCondition))  { ds >> i8; m_scondition = SubCondition(i8); }
+    if (has(DeltaField::Retain))        { ds >> b; m_retain = b; }
+    if (has(DeltaField::Stockroom))     { ds >> i8; m_stockroom = Stockroom(i8); }
+    if (has(DeltaField::Alternate))     { ds >> b; m_alternate = b; }
+    if (has(DeltaField::AlternateId))   { ds >> u8; m_alt_id = u8; }
+    if (has(DeltaField::CounterPart))   { ds >> b; m_cpart = b; }
+    if (has(DeltaField::LotId))         ds >> m_lot_id;
+    if (has(DeltaField::Reserved))      ds >> m_reserved;
+    if (has(DeltaField::Comments))      ds >> m_comments;
+    if (has(DeltaField::Remarks))       ds >> m_remarks;
+    if (has(DeltaField::Quantity))      ds >> m_quantity;
+    if (has(DeltaField::BulkQuantity))  ds >> m_bulk_quantity;
+    if (has(DeltaField::TierQuantity0)) ds >> m_tier_quantity[0];
+    if (has(DeltaField::TierQuantity1)) ds >> m_tier_quantity[1];
+    if (has(DeltaField::TierQuantity2)) ds >> m_tier_quantity[2];
+    if (has(DeltaField::Sale))          ds >> m_sale;
+    if (has(DeltaField::Price))         ds >> m_price;
+    if (has(DeltaField::Cost))          ds >> m_cost;
+    if (has(DeltaField::TierPrice0))    ds >> m_tier_price[0];
+    if (has(DeltaField::TierPrice1))    ds >> m_tier_price[1];
+    if (has(DeltaField::TierPrice2))    ds >> m_tier_price[2];
+    if (has(DeltaField::Weight))        ds >> m_weight;
+    if (has(DeltaField::MarkerText))    ds >> m_markerText;
+    if (has(DeltaField::MarkerColor))   ds >> m_markerColor;
+    if (has(DeltaField::DateAdded))     ds >> m_dateAdded;
+    if (has(DeltaField::DateLastSold))  ds >> m_dateLastSold;
+}
+
 Lot *Lot::restore(QDataStream &ds, uint startChangelogAt)
 {
     std::unique_ptr<Lot> lot;
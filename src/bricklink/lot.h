@@ -143,6 +143,24 @@ public:
     void save(QDataStream &ds) const;
     static Lot *restore(QDataStream &ds, uint startChangelogAt);
 
+    // compact undo records: only the fields that actually changed are saved
+    enum class DeltaField {
+        Identity, // item, color and incomplete
+        Status, Condition, SubCondition, Retain, Stockroom, Alternate, AlternateId, CounterPart,
+        LotId, Reserved, Comments, Remarks, Quantity, BulkQuantity,
+        TierQuantity0, TierQuantity1, TierQuantity2, Sale, Price, Cost,
+        TierPrice0, TierPrice1, TierPrice2, Weight, MarkerText, MarkerColor,
+        DateAdded, DateLastSold,
+
+        Count
+    };
+    using DeltaFields = quint32;
+    static_assert(int(DeltaField::Count) <= 32);
+
+    DeltaFields differingFields(const Lot &other) const;
+    void saveFields(QDataStream &ds, DeltaFields fields) const;
+    void loadFields(QDataStream &ds, DeltaFields fields);
+
 private:
     const Item * m_item;
     const Color *m_color;
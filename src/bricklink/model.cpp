@@ -720,6 +720,7 @@ void ItemModel::setFilterItemType(const ItemType *it)
         return;
 
     m_itemtype_filter = it;
+    updateFacetCandidates();
     emit isFilteredChanged();
     invalidateFilter();
 }
@@ -734,6 +735,7 @@ void ItemModel::setFilterCategory(const Category *cat)
     if (cat == m_category_filter)
         return;
     m_category_filter = cat;
+    updateFacetCandidates();
     emit isFilteredChanged();
     invalidateFilter();
 }
@@ -748,6 +750,7 @@ void ItemModel::setFilterColor(const Color *col)
     if (col == m_color_filter)
         return;
     m_color_filter = col;
+    updateFacetCandidates();
     emit isFilteredChanged();
     invalidateFilter();
     emit dataChanged(index(0, 0), index(rowCount() - 1, 0));
@@ -765,7 +768,8 @@ void ItemModel::setFilterText(const QString &filter)
 
     m_text_filter = filter;
     m_filter_terms.clear();
-    m_filter_ids.clear();
+    m_filter_candidates.clear();
+    m_filter_items.clear();
     m_filter_ids_optional = true;
 
     const QStringList sl = filter.simplified().split(u' ');
@@ -807,7 +811,7 @@ void ItemModel::setFilterText(const QString &filter)
                         continue;
                     QByteArray ba = id.toLatin1();
                     if (auto item = core()->item(ba.at(0), ba.mid(1))) {
-                        m_filter_ids << ba;
+                        m_filter_items << item;
                         scanOrder << item;
                     }
                 }
@@ -828,16 +832,20 @@ void ItemModel::setFilterText(const QString &filter)
         }
     }
     // check for PCC ids
+    QStringList positiveTerms;
     for (const auto &ft : std::as_const(m_filter_terms)) {
+        if (!ft.m_negate)
+            positiveTerms << ft.m_text;
 
         bool ok = false;
         uint pccId = ft.m_text.toUInt(&ok);
         if (ok && pccId) {
             const auto &[pccItem, pccColor] = core()->partColorCode(pccId);
             if (pccItem)
-                m_filter_ids << QByteArray(pccItem->itemTypeId() + pccItem->id());
+                m_filter_items << pccItem;
         }
     }
+    m_filter_candidates = core()->itemTextCandidates(positiveTerms);
 
     emit isFilteredChanged();
     invalidateFilter();
@@ -868,9 +876,24 @@ void ItemModel::setFilterYearRange(int minYear, int maxYear)
         std::swap(minYear, maxYear);
     m_year_min_filter = minYear;
     m_year_max_filter = maxYear;
+    updateFacetCandidates();
     invalidateFilter();
 }
 
+void ItemModel::updateFacetCandidates()
+{
+    m_facet_candidates = core()->itemFacetCandidates(
+        (m_itemtype_filter != ItemTypeModel::AllItemTypes) ? m_itemtype_filter : nullptr,
+        (m_category_filter != CategoryModel::AllCategories) ? m_category_filter : nullptr,
+        m_color_filter, m_year_min_filter, m_year_max_filter);
+}
+
+bool ItemModel::isCandidate(const QBitArray &candidates, int index)
+{
+    return candidates.isNull()
+            || ((index >= 0) && (index < candidates.size()) && candidates.testBit(index));
+}
+
 bool ItemModel::lessThan(const void *p1, const void *p2, int column, Qt::SortOrder /*order*/) const
 {
     const Item *i1 = static_cast<const Item *>(p1);
@@ -887,35 +910,28 @@ bool ItemModel::filterAccepts(const void *pointer) const
 
     if (!item)
         return false;
-    else if (m_itemtype_filter && (m_itemtype_filter != ItemTypeModel::AllItemTypes) && (item->itemType() != m_itemtype_filter))
-        return false;
-    else if (m_category_filter && (m_category_filter != CategoryModel::AllCategories) && !item->categories(true).contains(m_category_filter))
+
+    // the item type, category, color and year filters are precomputed
+    const int index = pointerIndexOf(item);
+
+    if (!isCandidate(m_facet_candidates, index))
         return false;
     else if (m_inv_filter && !item->hasInventory())
         return false;
-    else if (m_color_filter && !item->hasKnownColor(m_color_filter))
-        return false;
-    else if (m_year_min_filter && (!item->yearReleased() || (item->yearReleased() < m_year_min_filter)))
-        return false;
-    else if (m_year_max_filter && (!item->yearLastProduced() || (item->yearLastProduced() > m_year_max_filter)))
-        return false;
     else {
-        QString matchStr = QString::fromLatin1(item->id()) + u' ' + item->name();
-        if (item->hasAlternateIds())
-            matchStr = matchStr + u' ' + QString::fromLatin1(item->alternateIds());
-
-        bool match = true;
-        for (const auto &ft : m_filter_terms)
-            match = match && (matchStr.contains(ft.m_text, Qt::CaseInsensitive) == !ft.m_negate); // contains() xor negate
-
-        bool idMatched = m_filter_ids.isEmpty() && !m_filter_ids_optional;
-        for (const auto &id : m_filter_ids) {
-            if (id == QByteArray(item->itemTypeId() + item->id())) {
-                idMatched = true;
-                break;
-            }
+        // most items are already ruled out by the trigram index
+        bool match = isCandidate(m_filter_candidates, index);
+
+        if (match && !m_filter_terms.isEmpty()) {
+            const QString matchStr = Database::itemSearchText(*item);
+
+            for (const auto &ft : m_filter_terms)
+                match = match && (matchStr.contains(ft.m_text, Qt::CaseInsensitive) == !ft.m_negate); // contains() xor negate
         }
 
+        bool idMatched = (m_filter_items.isEmpty() && !m_filter_ids_optional)
+                || m_filter_items.contains(item);
+
         if (m_filter_ids_optional)
             return match || idMatched;
         else
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <QAbstractListModel>
+#include <QBitArray>
 #include <QSortFilterProxyModel>
 #include <QtQml/qqmlregistration.h>
 
@@ -211,6 +212,9 @@ protected:
     bool lessThan(const void *pointer1, const void *pointer2, int column, Qt::SortOrder order) const override;
 
 private:
+    void updateFacetCandidates();
+    static bool isCandidate(const QBitArray &candidates, int index);
+
     const ItemType *m_itemtype_filter = nullptr;
     const Category *m_category_filter = nullptr;
     const Color *   m_color_filter = nullptr;
@@ -224,7 +228,9 @@ private:
     };
 
     QVector<FilterTerm> m_filter_terms;
-    QByteArrayList  m_filter_ids;
+    QBitArray       m_filter_candidates; // from the trigram index, null if not usable
+    QBitArray       m_facet_candidates;  // item type, category, color and year, null if unfiltered
+    QVector<const Item *> m_filter_items;
     bool            m_filter_ids_optional = false;
     bool            m_inv_filter = false;
     int             m_year_min_filter = 0;
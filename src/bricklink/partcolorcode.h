@@ -8,7 +8,8 @@
 
 namespace BrickLink {
 
-// deprecated with DB v11 and only kept around to generate older DB versions
+// Not stored in the DB anymore since v11: this is now only a lookup index, derived from the
+// items' PCCs after loading (and still used to generate older DB versions)
 
 class PartColorCode
 {
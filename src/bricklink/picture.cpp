@@ -16,6 +16,7 @@
 #include "bricklink/picture_p.h"
 #include "bricklink/item.h"
 #include "bricklink/core.h"
+#include "bricklink/diskcache.h"
 #include "utility/appstatistics.h"
 #include "utility/transfer.h"
 
@@ -113,6 +114,9 @@ PictureCache::PictureCache(Core *core, quint64 physicalMem)
     d->m_cacheStatId = AppStatistics::inst()->addSource(u"Pictures in memory cache"_qs);
     d->m_loadsStatId = AppStatistics::inst()->addSource(u"Pictures queued for disk load"_qs);
     d->m_savesStatId = AppStatistics::inst()->addSource(u"Pictures queued for disk save"_qs);
+    d->m_decodesStatId = AppStatistics::inst()->addSource(u"Pictures queued for decoding"_qs);
+    d->m_encodesStatId = AppStatistics::inst()->addSource(u"Pictures queued for encoding"_qs);
+    d->m_diskSizeStatId = AppStatistics::inst()->addSource(u"Picture cache on disk"_qs, u"MB"_qs);
 
     // The max. pic cache size is at least 500MB. On 64bit systems, this gets expanded to a quarter
     // of the physical memory, but it is capped at 4GB
@@ -144,6 +148,8 @@ PictureCache::PictureCache(Core *core, quint64 physicalMem)
     }
 
     if (d->m_db.isOpen()) {
+        DiskCache::enableIncrementalVacuum(d->m_db);
+
         QSqlQuery createQuery(d->m_db);
         if (!createQuery.exec(
                     u"CREATE TABLE IF NOT EXISTS pic ("
@@ -154,6 +160,10 @@ PictureCache::PictureCache(Core *core, quint64 physicalMem)
             qCWarning(LogSql) << "Failed to create the 'pic' table in the picture database:"
                               << createQuery.lastError().text();
             d->m_db.close();
+        } else if (!createQuery.exec(u"CREATE INDEX IF NOT EXISTS pic_accessed ON pic(accessed);"_qs)) {
+            // the eviction will be slower, but still works
+            qCWarning(LogSql) << "Failed to create the 'accessed' index in the picture database:"
+                              << createQuery.lastError().text();
         }
     }
 
@@ -227,11 +237,13 @@ PictureCache::PictureCache(Core *core, quint64 physicalMem)
     }
 #endif
 
-    //TODO: on mobile: if DB size > maxSize, remove old entries until size <= maxSize
+    // the on-disk size is enforced by the saver thread: see setMaxDiskSize()
 
-    for (int i = 0; i < 1 /*qMax(2, QThread::idealThreadCount() / 4)*/; ++i) {
-        auto t = QThread::create(&PictureCachePrivate::saveThread, d, d->m_db.connectionName(), i);
-        t->setObjectName(u"Pic Saver %1"_qs.arg(i));
+    // SQLite only supports one writer at a time anyway, so there is exactly one saver thread.
+    // The WebP encoding is done in m_encodePool before a picture is queued for saving.
+    {
+        auto t = QThread::create(&PictureCachePrivate::saveThread, d, d->m_db.connectionName(), 0);
+        t->setObjectName(u"Pic Saver"_qs);
         d->m_threads.append(t);
     }
     for (int i = 0; i < std::clamp(QThread::idealThreadCount(), 2, 8); ++i) {
@@ -240,6 +252,13 @@ PictureCache::PictureCache(Core *core, quint64 physicalMem)
         d->m_threads.append(t);
     }
 
+    d->m_decodePool.setObjectName(u"Pic Decoder"_qs);
+    d->m_decodePool.setMaxThreadCount(std::clamp(QThread::idealThreadCount() / 2, 1, 4));
+    d->m_decodePool.setThreadPriority(QThread::LowPriority);
+    d->m_encodePool.setObjectName(u"Pic Encoder"_qs);
+    d->m_encodePool.setMaxThreadCount(std::clamp(QThread::idealThreadCount() / 2, 1, 4));
+    d->m_encodePool.setThreadPriority(QThread::LowPriority);
+
     for (auto *thread : d->m_threads)
         thread->start(QThread::LowPriority);
 }
@@ -257,6 +276,8 @@ PictureCache::~PictureCache()
         thread->wait();
         delete thread;
     }
+    d->m_decodePool.waitForDone();
+    d->m_encodePool.waitForDone();
     d->m_db.close();
     delete d;
     Picture::s_cache = nullptr;
@@ -267,6 +288,16 @@ void PictureCache::setUpdateInterval(int interval)
     d->m_updateInterval = interval;
 }
 
+void PictureCache::setMaxDiskSize(qint64 bytes)
+{
+    d->m_maxDiskSize = std::max<qint64>(0, bytes);
+
+    // the saver thread does the actual eviction
+    QMutexLocker locker(&d->m_saveMutex);
+    d->m_compactionNeeded = true;
+    d->m_saveTrigger.wakeAll();
+}
+
 void PictureCache::clearCache()
 {
     int lastLeftOver = 0;
@@ -480,8 +511,31 @@ void PictureCachePrivate::save(Picture *pic)
         return;
 
     pic->addRef();
+    AppStatistics::inst()->update(m_encodesStatId, ++m_encodeQueueSize);
+
+    // Encoding is by far the most expensive part of saving, so it is fanned out to a pool,
+    // leaving only the actual DB writes to the saver thread.
+    m_encodePool.start([this, pic, img = pic->m_image]() {
+        if (m_stop) {
+            pic->release();
+        } else {
+            QByteArray data;
+            if (!img.isNull()) {
+                // WebP lossy at 80% compresses to ~10-20% of the original PNG size
+                // with next to no visible artifacts
+                QBuffer buffer(&data);
+                img.save(&buffer, "WEBP", 80);
+            }
+            queueSave(pic, SaveData, data); // takes over our reference
+        }
+        AppStatistics::inst()->update(m_encodesStatId, --m_encodeQueueSize);
+    });
+}
+
+void PictureCachePrivate::queueSave(Picture *pic, SaveType saveType, const QByteArray &data)
+{
     m_saveMutex.lock();
-    m_saveQueue.append({ pic, SaveData });
+    m_saveQueue.append({ pic, saveType, data });
     m_saveTrigger.wakeOne();
     auto queueSize = m_saveQueue.size();
     m_saveMutex.unlock();
@@ -494,8 +548,14 @@ void PictureCachePrivate::loadThread(QString dbName, int index)
     auto db = QSqlDatabase::cloneDatabase(dbName, dbName + u"_Reader_" + QString::number(index));
     db.open();
 
+    // We prepare a single statement for a full batch: unused placeholders are bound to NULL,
+    // which never matches an id.
+    QString placeholders = u"?"_qs;
+    for (int i = 1; i < MaxLoadBatchSize; ++i)
+        placeholders.append(u",?");
+
     QSqlQuery loadQuery(db);
-    loadQuery.prepare(u"SELECT updated,data FROM pic WHERE id=:id;"_qs);
+    loadQuery.prepare(u"SELECT id,updated,data FROM pic WHERE id IN (" + placeholders + u");");
 
     while (!m_stop) {
         QMutexLocker locker(&m_loadMutex);
@@ -509,32 +569,55 @@ void PictureCachePrivate::loadThread(QString dbName, int index)
         }
 
         if (!m_loadQueue.isEmpty()) {
-            auto [pic, loadType] = m_loadQueue.takeFirst();
+            // the queue is sorted by priority, so the batch contains the most urgent requests
+            const auto batch = m_loadQueue.mid(0, MaxLoadBatchSize);
+            m_loadQueue.remove(0, batch.size());
             auto queueSize = m_loadQueue.size();
             locker.unlock();
 
             AppStatistics::inst()->update(m_loadsStatId, queueSize);
 
-            bool loaded = false;
-            QDateTime lastUpdated;
-            QImage img;
-            bool highPriority = (loadType == LoadHighPriority);
-            bool convertedFromOldCache = false;
+            QVector<QString> dbTags;
+            dbTags.reserve(batch.size());
+            for (const auto &[pic, loadType] : batch)
+                dbTags.append(databaseTag(pic));
+
+            QVector<bool> found(batch.size(), false);
 
             if (db.isOpen()) {
-                loadQuery.bindValue(u":id"_qs, databaseTag(pic));
-
-                loadQuery.exec();
-                if (loadQuery.next()) {
-                    lastUpdated = loadQuery.isNull(0) ? QDateTime()
-                                                      : QDateTime::fromMSecsSinceEpoch(loadQuery.value(0).toLongLong());
-                    auto data = loadQuery.value(1).toByteArray();
-                    loaded = imageFromData(img, data);
+                for (int i = 0; i < MaxLoadBatchSize; ++i)
+                    loadQuery.bindValue(i, (i < dbTags.size()) ? QVariant(dbTags.at(i)) : QVariant(QMetaType::fromType<QString>()));
+
+                if (!loadQuery.exec()) {
+                    qCWarning(LogSql) << "Failed to load pictures:" << loadQuery.lastError().text();
+                } else {
+                    while (loadQuery.next()) {
+                        const auto i = dbTags.indexOf(loadQuery.value(0).toString());
+                        if ((i < 0) || found.at(i))
+                            continue;
+                        found[i] = true;
+
+                        auto lastUpdated = loadQuery.isNull(1) ? QDateTime()
+                                                               : QDateTime::fromMSecsSinceEpoch(loadQuery.value(1).toLongLong());
+
+                        // the decode pool takes over our reference
+                        decode(batch.at(i).first, batch.at(i).second, lastUpdated,
+                               loadQuery.value(2).toByteArray());
+                    }
                 }
                 loadQuery.finish();
             }
-            // try the old file-system based cache
-            if (!loaded) {
+
+            for (qsizetype i = 0; i < batch.size(); ++i) {
+                if (found.at(i))
+                    continue;
+
+                auto [pic, loadType] = batch.at(i);
+                bool loaded = false;
+                QDateTime lastUpdated;
+                QImage img;
+
+                // try the old file-system based cache
                 bool large = (!pic->color());
                 bool hasColors = pic->item()->itemType()->hasColors();
                 QFile *f = m_core->dataReadFile(large ? u"large.jpg" : u"normal.png", pic->item(),
@@ -542,45 +625,72 @@ void PictureCachePrivate::loadThread(QString dbName, int index)
                 if (f && f->isOpen()) {
                     lastUpdated = f->fileTime(QFile::FileModificationTime);
                     if (f->size() > 0)
-                        convertedFromOldCache = loaded = imageFromData(img, f->readAll());
+                        loaded = imageFromData(img, f->readAll());
                     f->remove();
                 }
                 delete f;
+
+                loadFinished(pic, loadType, loaded, lastUpdated, img, loaded);
+                pic->release();
             }
+        }
+    }
+    db.close();
+}
 
-            pic->addRef(); // the release will happen on the main thread (see the invokeMethod below)
-            QMetaObject::invokeMethod(m_core, [=, this, pic=pic]() { // clang bug: P1091R3
-                if (loaded) {
-                    pic->setLastUpdated(lastUpdated);
-                    pic->setImage(img);
-
-                    // update the last accessed time stamp
-                    pic->addRef();
-                    m_saveMutex.lock();
-                    m_saveQueue.append({ pic, convertedFromOldCache ? SaveData : SaveAccessTimeOnly });
-                    m_saveTrigger.wakeOne();
-                    m_saveMutex.unlock();
-                }
-                pic->setIsValid(loaded);
-                pic->setUpdateStatus(UpdateStatus::Ok);
+void PictureCachePrivate::decode(Picture *pic, LoadType loadType, const QDateTime &lastUpdated,
+                                 const QByteArray &data)
+{
+    // Decoding a WebP image takes longer than reading it from the DB, so we do it in a separate
+    // pool. This way the loaders can already fetch the next batch in the meantime.
+    AppStatistics::inst()->update(m_decodesStatId, ++m_decodeQueueSize);
 
-                if (pic->m_updateAfterLoad || isUpdateNeeded(pic))  {
-                    pic->m_updateAfterLoad = false;
-                    q->updatePicture(pic, highPriority);
-                }
-                if (loaded && img.isNull())
-                    pic->setIsValid(false);
+    m_decodePool.start([=, this]() {
+        QImage img;
+        bool loaded = !m_stop && imageFromData(img, data);
 
-                m_cache.setObjectCost(cacheKey(pic->item(), pic->color()), pic->cost());
+        loadFinished(pic, loadType, loaded, lastUpdated, img, false);
+        pic->release();
 
-                emit q->pictureUpdated(pic);
-                pic->release();
-            }, Qt::QueuedConnection);
+        AppStatistics::inst()->update(m_decodesStatId, --m_decodeQueueSize);
+    });
+}
 
-            pic->release();
+void PictureCachePrivate::loadFinished(Picture *pic, LoadType loadType, bool loaded,
+                                       const QDateTime &lastUpdated, const QImage &img,
+                                       bool convertedFromOldCache)
+{
+    const bool highPriority = (loadType == LoadHighPriority);
+
+    pic->addRef(); // the release will happen on the main thread (see the invokeMethod below)
+    QMetaObject::invokeMethod(m_core, [=, this]() {
+        if (loaded) {
+            pic->setLastUpdated(lastUpdated);
+            pic->setImage(img);
+
+            // update the last accessed time stamp
+            if (convertedFromOldCache) {
+                save(pic);
+            } else {
+                pic->addRef();
+                queueSave(pic, SaveAccessTimeOnly);
+            }
         }
-    }
-    db.close();
+        pic->setIsValid(loaded);
+        pic->setUpdateStatus(UpdateStatus::Ok);
+
+        if (pic->m_updateAfterLoad || isUpdateNeeded(pic))  {
+            pic->m_updateAfterLoad = false;
+            q->updatePicture(pic, highPriority);
+        }
+        if (loaded && img.isNull())
+            pic->setIsValid(false);
+
+        m_cache.setObjectCost(cacheKey(pic->item(), pic->color()), pic->cost());
+
+        emit q->pictureUpdated(pic);
+        pic->release();
+    }, Qt::QueuedConnection);
 }
 
 void PictureCachePrivate::saveThread(QString dbName, int index)
@@ -593,61 +703,44 @@ void PictureCachePrivate::saveThread(QString dbName, int index)
                       "ON CONFLICT(id) DO UPDATE "
                       "SET updated=excluded.updated,accessed=excluded.accessed,data=excluded.data;"_qs);
 
+    // see loadThread() regarding the unused placeholders
+    QString placeholders = u"?"_qs;
+    for (int i = 1; i < MaxAccessBatchSize; ++i)
+        placeholders.append(u",?");
+
     QSqlQuery accessQuery(db);
-    accessQuery.prepare(u"UPDATE pic SET accessed=:accessed WHERE id=:id;"_qs);
+    accessQuery.prepare(u"UPDATE pic SET accessed=? WHERE id IN (" + placeholders + u");");
+
+    QElapsedTimer compactionTimer;
+    compactionTimer.start();
 
     while (!m_stop) {
         QMutexLocker locker(&m_saveMutex);
-        if (m_saveQueue.isEmpty())
+        // a pending compaction can only run on an open database
+        if (m_saveQueue.isEmpty() && (!m_compactionNeeded || !db.isOpen()))
             m_saveTrigger.wait(&m_saveMutex);
 
         if (!m_saveQueue.isEmpty()) {
-            // we might have multiple saver threads, so don't grab the full queue at once
-            const auto saveQueueCopy = m_saveQueue.mid(0, 20);
+            // the bigger the backlog, the bigger the transaction: committing is the expensive part
+            const auto saveQueueCopy = m_saveQueue.mid(0, MaxSaveBatchSize);
             m_saveQueue.remove(0, saveQueueCopy.size());
             auto queueSize = m_saveQueue.size();
             locker.unlock();
 
             AppStatistics::inst()->update(m_savesStatId, queueSize);
 
-            QHash<Picture *, QByteArray> imageDataHash;
-
-            // do all this before starting a DB transaction, to keep lock times to a minimum
-            for (auto [pic, saveType] : saveQueueCopy) {
-                if (saveType == SaveData) {
-                    QByteArray data;
-                    if (!pic->m_image.isNull()) {
-                        // WebP lossy at 80% compresses to ~10-20% of the original PNG size
-                        // with next to no visible artifacts
-                        QByteArray webpData;
-                        QBuffer buffer(&webpData);
-                        pic->m_image.save(&buffer, "WEBP", 80);
-                        //if (webpData.size() < data.size())
-                        //    qWarning() << "Saving image as WEBP compresses to" << (100 * webpData.size() / data.size()) << "%";
-                        data = webpData;
-                    }
-                    imageDataHash.insert(pic, data);
-                }
-            }
-
             if (db.isOpen()) {
                 db.transaction();
 
                 qint64 now = QDateTime::currentMSecsSinceEpoch();
+                QStringList accessDbTags;
 
-                for (auto [pic, saveType] : saveQueueCopy) {
+                for (const auto &[pic, saveType, data] : saveQueueCopy) {
                     auto dbTag = databaseTag(pic);
 
                     if (saveType == SaveAccessTimeOnly) {
-                        accessQuery.bindValue(u":id"_qs, dbTag);
-                        accessQuery.bindValue(u":accessed"_qs, now);
-                        if (!accessQuery.exec()) {
-                            qCWarning(LogSql) << "Failed to update the access time of a picture:"
-                                              << accessQuery.lastError().text();
-                        }
-                        accessQuery.finish();
+                        accessDbTags.append(dbTag);
                     } else {
-                        const auto data = imageDataHash.value(pic);
                         auto lastUpdated = QVariant(QMetaType::fromType<qint64>());
                         if (pic->lastUpdated().isValid())
                             lastUpdated = QVariant::fromValue(pic->lastUpdated().toMSecsSinceEpoch());
@@ -663,10 +756,35 @@ void PictureCachePrivate::saveThread(QString dbName, int index)
                         }
                         saveQuery.finish();
                     }
-                    pic->release();
+                }
+
+                for (qsizetype from = 0; from < accessDbTags.size(); from += MaxAccessBatchSize) {
+                    accessQuery.bindValue(0, now);
+                    for (int i = 0; i < MaxAccessBatchSize; ++i) {
+                        accessQuery.bindValue(i + 1, ((from + i) < accessDbTags.size())
+                                                         ? QVariant(accessDbTags.at(from + i))
+                                                         : QVariant(QMetaType::fromType<QString>()));
+                    }
+                    if (!accessQuery.exec()) {
+                        qCWarning(LogSql) << "Failed to update the access time of pictures:"
+                                          << accessQuery.lastError().text();
+                    }
+                    accessQuery.finish();
                 }
                 db.commit();
             }
+            for (const auto &request : saveQueueCopy)
+                request.pic->release();
+        } else {
+            locker.unlock();
+        }
+
+        // only saves can grow the database, so there is no need for a timer of its own
+        if (db.isOpen() && !m_stop && (m_compactionNeeded.testAndSetRelaxed(true, false)
+                                       || compactionTimer.hasExpired(CompactionInterval))) {
+            auto size = DiskCache::compact(db, u"pic"_qs, m_maxDiskSize.loadRelaxed());
+            AppStatistics::inst()->update(m_diskSizeStatId, size / 1'000'000);
+            compactionTimer.start();
         }
     }
     db.close();
@@ -97,6 +97,7 @@ public:
     ~PictureCache() override;
 
     void setUpdateInterval(int interval);
+    void setMaxDiskSize(qint64 bytes);
     void clearCache();
     QPair<int, int> cacheStats() const;
 
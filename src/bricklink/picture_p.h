@@ -6,6 +6,7 @@
 #include <QtCore/QByteArray>
 #include <QtCore/QAtomicInt>
 #include <QtCore/QMutex>
+#include <QtCore/QThreadPool>
 #include <QtCore/QWaitCondition>
 #include <QtCore/QVector>
 #include <QtSql/QSqlDatabase>
@@ -39,19 +40,44 @@ public:
         SaveAccessTimeOnly,
     };
 
+    struct SaveRequest {
+        Picture *pic;
+        SaveType saveType;
+        QByteArray data; // the already encoded image for SaveData
+    };
+
     QVector<std::pair<Picture *, LoadType>> m_loadQueue;
-    QVector<std::pair<Picture *, SaveType>> m_saveQueue;
+    QVector<SaveRequest> m_saveQueue;
     QString m_dbName;
     QSqlDatabase m_db;
     QVector<QThread *> m_threads;
+    QThreadPool m_decodePool;
+    QAtomicInt m_decodeQueueSize = 0;
+    QThreadPool m_encodePool;
+    QAtomicInt m_encodeQueueSize = 0;
+
+    // the loaders fetch this many pictures with a single SELECT
+    static constexpr int MaxLoadBatchSize = 50;
+    // the saver commits up to this many pictures in one transaction, depending on the backlog
+    static constexpr int MaxSaveBatchSize = 500;
+    // access time updates are coalesced into a single UPDATE for this many pictures
+    static constexpr int MaxAccessBatchSize = 100;
+
+    // the saver checks the on-disk size at most this often
+    static constexpr int CompactionInterval = 60 * 1000; // msec
 
     int m_updateInterval = 0;
+    QAtomicInteger<qint64> m_maxDiskSize = 0; // 0 means unlimited
+    QAtomicInt m_compactionNeeded = true;
     Q3Cache<quint32, Picture> m_cache;
     Core *m_core;
     PictureCache *q;
     int m_cacheStatId = -1;
     int m_loadsStatId = -1;
     int m_savesStatId = -1;
+    int m_decodesStatId = -1;
+    int m_encodesStatId = -1;
+    int m_diskSizeStatId = -1;
 
     static quint32 cacheKey(const Item *item, const Color *color);
     static QString databaseTag(Picture *pic);
@@ -61,7 +87,11 @@ public:
     void load(Picture *pic, bool highPriority);
     void reprioritize(Picture *pic, bool highPriority);
     void save(Picture *pic);
+    void queueSave(Picture *pic, SaveType saveType, const QByteArray &data = { });
     void loadThread(QString dbName, int index);
+    void decode(Picture *pic, LoadType loadType, const QDateTime &lastUpdated, const QByteArray &data);
+    void loadFinished(Picture *pic, LoadType loadType, bool loaded, const QDateTime &lastUpdated,
+                      const QImage &img, bool convertedFromOldCache);
     void saveThread(QString dbName, int index);
     void transferJobFinished(TransferJob *j, Picture *pic);
 };
@@ -24,6 +24,7 @@
 #include "bricklink/priceguide.h"
 #include "bricklink/priceguide_p.h"
 #include "bricklink/core.h"
+#include "bricklink/diskcache.h"
 #include "bricklink/item.h"
 #include "bricklink/color.h"
 
@@ -264,8 +265,6 @@ BatchedAffiliateAPIPGRetriever::BatchedAffiliateAPIPGRetriever(Core *core, const
     m_batchTimer->setInterval(MaxBatchAgeMSec);
     connect(m_batchTimer, &QTimer::timeout, this, &BatchedAffiliateAPIPGRetriever::check);
 
-    m_currentBatch.reserve(MaxBatchSize);
-
     connect(m_core, &Core::transferFinished,
             this, [this](TransferJob *job) {
         if (job) {
@@ -284,21 +283,21 @@ QVector<VatType> BatchedAffiliateAPIPGRetriever::supportedVatTypes() const
 void BatchedAffiliateAPIPGRetriever::fetch(PriceGuide *pg, bool highPriority)
 {
     // check if the pg is currently being fetched
-    if (m_currentBatch.contains(pg))
-        return;
+    for (const auto &batch : std::as_const(m_batches)) {
+        if (batch.priceGuides.contains(pg))
+            return;
+    }
 
-    bool wrongVatType = (pg->vatType() != m_nextBatchVatType);
-    auto &queue = wrongVatType ? m_wrongVatTypeQueue : m_nextBatch;
-    auto &prioSize = wrongVatType ? m_wrongVatTypeQueuePrioritySize : m_nextBatchPrioritySize;
+    auto &queue = m_queues[pg->vatType()];
 
-    // check if the pg is already scheduled for the next batch and if we need to up the priority
-    auto it = std::find_if(queue.cbegin(), queue.cend(), [pg](const auto &pair) {
+    // check if the pg is already scheduled for a future batch and if we need to up the priority
+    auto it = std::find_if(queue.entries.cbegin(), queue.entries.cend(), [pg](const auto &pair) {
         return (pair.first == pg);
     });
-    if (it != queue.cend()) {
-        auto index = std::distance(queue.cbegin(), it);
-        if (index >= prioSize)
-            queue.move(index, prioSize++);
+    if (it != queue.entries.cend()) {
+        auto index = std::distance(queue.entries.cbegin(), it);
+        if (index >= queue.prioritySize)
+            queue.entries.move(index, queue.prioritySize++);
         return;
     }
 
@@ -308,30 +307,35 @@ void BatchedAffiliateAPIPGRetriever::fetch(PriceGuide *pg, bool highPriority)
     now.start();
 
     if (highPriority)
-        queue.emplace(prioSize++, pg, now);
+        queue.entries.emplace(queue.prioritySize++, pg, now);
     else
-        queue.emplace_back(pg, now);
+        queue.entries.emplace_back(pg, now);
 
     check();
 }
 
 void BatchedAffiliateAPIPGRetriever::cancel(PriceGuide *pg)
 {
-    if (m_currentBatch.contains(pg))
-        m_currentJob->abort();
+    for (const auto &batch : std::as_const(m_batches)) {
+        if (batch.priceGuides.contains(pg)) {
+            batch.job->abort();
+            break;
+        }
+    }
 
-    bool wrongVatType = (pg->vatType() != m_nextBatchVatType);
-    auto &queue = wrongVatType ? m_wrongVatTypeQueue : m_nextBatch;
-    auto &prioSize = wrongVatType ? m_wrongVatTypeQueuePrioritySize : m_nextBatchPrioritySize;
+    auto qit = m_queues.find(pg->vatType());
+    if (qit == m_queues.end())
+        return;
+    auto &queue = *qit;
 
-    auto it = std::find_if(queue.cbegin(), queue.cend(), [pg](const auto &pair) {
+    auto it = std::find_if(queue.entries.cbegin(), queue.entries.cend(), [pg](const auto &pair) {
         return (pair.first == pg);
     });
-    if (it != queue.cend()) {
-        auto index = std::distance(queue.cbegin(), it);
-        if (index < prioSize)
-            --prioSize;
-        queue.removeAt(index);
+    if (it != queue.entries.cend()) {
+        auto index = std::distance(queue.entries.cbegin(), it);
+        if (index < queue.prioritySize)
+            --queue.prioritySize;
+        queue.entries.removeAt(index);
 
         emit failed(pg, u"aborted"_qs);
         pg->release();
@@ -340,15 +344,13 @@ void BatchedAffiliateAPIPGRetriever::cancel(PriceGuide *pg)
 
 void BatchedAffiliateAPIPGRetriever::cancelAll()
 {
-    if (m_currentJob)
-        m_currentJob->abort();
+    for (const auto &batch : std::as_const(m_batches))
+        batch.job->abort();
 
-    const auto list = m_wrongVatTypeQueue + m_nextBatch;
-
-    m_wrongVatTypeQueue.clear();
-    m_nextBatch.clear();
-    m_wrongVatTypeQueuePrioritySize = 0;
-    m_nextBatchPrioritySize = 0;
+    QVector<std::pair<PriceGuide *, QElapsedTimer>> list;
+    for (const auto &queue : std::as_const(m_queues))
+        list.append(queue.entries);
+    m_queues.clear();
 
     for (const auto &pair : list) {
         emit failed(pair.first, u"aborted"_qs);
@@ -362,85 +364,130 @@ void BatchedAffiliateAPIPGRetriever::setApiKey(const QString &key)
         m_apiKey = key;
 }
 
+void BatchedAffiliateAPIPGRetriever::setMaxConcurrentBatches(int count)
+{
+    m_maxConcurrentBatches = std::max(1, count);
+    // more room may be available now
+    QMetaObject::invokeMethod(this, &BatchedAffiliateAPIPGRetriever::check, Qt::QueuedConnection);
+}
+
 void BatchedAffiliateAPIPGRetriever::check()
 {
-    if (m_currentBatch.isEmpty() && !m_currentJob) {
-        if (m_nextBatch.isEmpty() && !m_wrongVatTypeQueue.isEmpty()) {
-            // switch vatType to the request with the highest priority
-            m_nextBatchVatType = m_wrongVatTypeQueue.constFirst().first->vatType();
-
-            // move all requests with the same vatType to nextBatch
-            qsizetype highPrioMoved = 0;
-            for (auto i = 0; i < m_wrongVatTypeQueue.size(); ++i) {
-                auto [pg, age] = m_wrongVatTypeQueue.at(i);
-                if (pg->vatType() == m_nextBatchVatType) {
-                    if (i < m_wrongVatTypeQueuePrioritySize)
-                        ++highPrioMoved;
-                    m_nextBatch.emplace_back(pg, age);
-                    // just tag now, as we can't remove directly: this would mess up the indices
-                    m_wrongVatTypeQueue[i].first = nullptr;
-                }
+    while (m_batches.size() < m_maxConcurrentBatches) {
+        // Find the VAT type to send a batch for: queues with high priority requests go first,
+        // otherwise the one with the oldest request wins.
+        VatType nextVatType = VatType::Excluded;
+        Queue *next = nullptr;
+        bool nextIsPriority = false;
+        qint64 nextAge = -1;
+        qint64 nextCheck = -1;
+
+        for (auto it = m_queues.begin(); it != m_queues.end(); ++it) {
+            auto &queue = *it;
+            qsizetype size = queue.entries.size();
+            if (!size)
+                continue;
+
+            qint64 age = (queue.prioritySize >= size)
+                    ? 0 : queue.entries.at(queue.prioritySize).second.elapsed();
+            qint64 priorityAge = (queue.prioritySize <= 0)
+                    ? 0 : queue.entries.at(0).second.elapsed();
+            age = std::max(age, priorityAge);
+
+            if ((size < m_batchSize) && (age <= MaxBatchAgeMSec)) {
+                qint64 wait = std::max(0LL, MaxBatchAgeMSec - age);
+                nextCheck = (nextCheck < 0) ? wait : std::min(nextCheck, wait);
+                continue;
+            }
+
+            bool isPriority = (queue.prioritySize > 0);
+            if (!next || (isPriority && !nextIsPriority)
+                    || ((isPriority == nextIsPriority) && (age > nextAge))) {
+                nextVatType = it.key();
+                next = &queue;
+                nextIsPriority = isPriority;
+                nextAge = age;
             }
-            m_nextBatchPrioritySize = highPrioMoved;
-            m_wrongVatTypeQueuePrioritySize -= highPrioMoved;
-            // finally remove all the tagged entries
-            m_wrongVatTypeQueue.removeIf([](const auto &pair) { return pair.first == nullptr; });
         }
 
-        qsizetype nextSize = m_nextBatch.size();
-        qint64 nextAge = (m_nextBatchPrioritySize >= nextSize)
-                ? 0 : m_nextBatch.at(m_nextBatchPrioritySize).second.elapsed();
-        qint64 nextPriorityAge = (m_nextBatchPrioritySize <= 0)
-                ? 0 : m_nextBatch.at(0).second.elapsed();
-
-        if ((nextSize >= MaxBatchSize) || (qMax(nextAge, nextPriorityAge) > MaxBatchAgeMSec)) {
-            auto batchSize = qMin(nextSize, MaxBatchSize);
-            QJsonArray array;
-
-            for (auto i = 0; i < batchSize; ++i) {
-                auto *pg = m_nextBatch.at(i).first;
-                const QString itemId = QString::fromLatin1(pg->item()->id());
-                const QString typeId = itemTypeApiId(pg->item()->itemType());
-                int colorId = int(pg->color()->id());
-
-                m_currentBatch.append(pg);
-
-                array.append(QJsonObject {
-                                 { u"color_id"_qs, colorId },
-                                 { u"item"_qs, QJsonObject {
-                                       { u"no"_qs, itemId },
-                                       { u"type"_qs, typeId },
-                                   } },
-                             });
+        if (!next) {
+            if (nextCheck >= 0) {
+                m_batchTimer->setInterval(int(nextCheck));
+                m_batchTimer->start();
             }
-            m_nextBatch.remove(0, batchSize);
-            m_nextBatchPrioritySize -= qMin(m_nextBatchPrioritySize, batchSize);
-
-            const auto json = QJsonDocument(array).toJson(QJsonDocument::Compact);
-
-            m_currentJob = TransferJob::post(u"https://api.bricklink.com/api/affiliate/v1/price_guide_batch"_qs,
-                                             {
-                                              { u"currency_code"_qs, u"USD"_qs },
-                                              { u"precision"_qs,     u"4"_qs },
-                                              { u"vat_type"_qs,      QString::number(int(m_nextBatchVatType)) },
-                                              { u"api_key"_qs,       m_apiKey }
-                                             },
-                                             u"application/json"_qs, json);
-
-            m_currentJob->setUserData("batchedPriceGuide", true);
-            m_core->retrieve(m_currentJob, m_nextBatchPrioritySize > 0);
-        } else if (nextSize) {
-            auto nextCheck = std::max(0LL, (MaxBatchAgeMSec - std::max(nextAge, nextPriorityAge)));
-            m_batchTimer->setInterval(int(nextCheck));
-            m_batchTimer->start();
+            break;
         }
+        startBatch(nextVatType, *next);
+    }
+}
+
+void BatchedAffiliateAPIPGRetriever::startBatch(VatType vatType, Queue &queue)
+{
+    auto batchSize = std::min(queue.entries.size(), m_batchSize);
+    bool highPriority = (queue.prioritySize > 0);
+
+    Batch batch;
+    batch.priceGuides.reserve(batchSize);
+    QJsonArray array;
+
+    for (auto i = 0; i < batchSize; ++i) {
+        auto *pg = queue.entries.at(i).first;
+        const QString itemId = QString::fromLatin1(pg->item()->id());
+        const QString typeId = itemTypeApiId(pg->item()->itemType());
+        int colorId = int(pg->color()->id());
+
+        batch.priceGuides.append(pg);
+
+        array.append(QJsonObject {
+                         { u"color_id"_qs, colorId },
+                         { u"item"_qs, QJsonObject {
+                               { u"no"_qs, itemId },
+                               { u"type"_qs, typeId },
+                           } },
+                     });
     }
+    queue.entries.remove(0, batchSize);
+    queue.prioritySize -= std::min(queue.prioritySize, batchSize);
+
+    const auto json = QJsonDocument(array).toJson(QJsonDocument::Compact);
+
+    batch.job = TransferJob::post(u"https://api.bricklink.com/api/affiliate/v1/price_guide_batch"_qs,
+                                  {
+                                   { u"currency_code"_qs, u"USD"_qs },
+                                   { u"precision"_qs,     u"4"_qs },
+                                   { u"vat_type"_qs,      QString::number(int(vatType)) },
+                                   { u"api_key"_qs,       m_apiKey }
+                                  },
+                                  u"application/json"_qs, json);
+
+    batch.job->setUserData("batchedPriceGuide", true);
+    batch.started.start();
+    auto *job = batch.job;
+    m_batches.append(batch);
+    m_core->retrieve(job, highPriority);
 }
 
 void BatchedAffiliateAPIPGRetriever::transferJobFinished(TransferJob *j)
 {
-    Q_ASSERT(m_currentJob == j);
-    m_currentJob = nullptr;
+    auto bit = std::find_if(m_batches.begin(), m_batches.end(), [j](const auto &batch) {
+        return (batch.job == j);
+    });
+    Q_ASSERT(bit != m_batches.end());
+    if (bit == m_batches.end())
+        return;
+
+    auto currentBatch = std::move(bit->priceGuides);
+    const qint64 latency = bit->started.elapsed();
+    m_batches.erase(bit);
+
+    if (j->isCompleted()) {
+        // Smaller batches are faster to get the first results in and spread better over the
+        // concurrent connections, bigger ones have less overhead per price guide.
+        if (latency > TargetBatchLatencyMSec)
+            m_batchSize = std::max(MinBatchSize, m_batchSize * 3 / 4);
+        else if ((latency < (TargetBatchLatencyMSec / 2)) && (currentBatch.size() >= m_batchSize))
+            m_batchSize = std::min(MaxBatchSize, m_batchSize * 5 / 4);
+    }
 
     try {
         if (j->isCompleted()) {
@@ -458,9 +505,9 @@ void BatchedAffiliateAPIPGRetriever::transferJobFinished(TransferJob *j)
                 throw Exception("bad request (%1). %2: %3").arg(code).arg(description).arg(message);
 
             const auto data = doc[u"data"].toArray();
-            if (data.size() != m_currentBatch.size()) {
+            if (data.size() != currentBatch.size()) {
                 throw Exception("JSON data size mismatch: requested %1, got %2")
-                    .arg(m_currentBatch.size()).arg(data.size());
+                    .arg(currentBatch.size()).arg(data.size());
             }
             for (const auto d : data) {
                 const auto item = d.toObject();
@@ -468,14 +515,14 @@ void BatchedAffiliateAPIPGRetriever::transferJobFinished(TransferJob *j)
                 const QString typeId = item[u"item"][u"type"].toString();
                 const int colorId = item[u"color_id"].toInt();
 
-                auto pit = std::find_if(m_currentBatch.begin(), m_currentBatch.end(),
+                auto pit = std::find_if(currentBatch.begin(), currentBatch.end(),
                                         [&](const auto *pg) {
                     return pg && (QLatin1String(pg->item()->id()) == itemId)
                             && (itemTypeApiId(pg->item()->itemType()) == typeId)
                             && (pg->color()->id() == uint(colorId));
                 });
 
-                if (pit == m_currentBatch.end()) {
+                if (pit == currentBatch.end()) {
                     qCWarning(LogCache) << "PG download was not requested, but received for"
                                         << typeId.mid(0, 1) << itemId << "in" << colorId;
                     continue;
@@ -505,7 +552,7 @@ void BatchedAffiliateAPIPGRetriever::transferJobFinished(TransferJob *j)
                 *pit = nullptr;  // mark as "dealt with"
             }
 
-            // Make sure to fail any remaining pg requests that might still be in m_currentBatch.
+            // Make sure to fail any remaining pg requests that might still be in currentBatch.
             // Ideally there are none, but throwing this Exception unconditionally doesn't hurt.
             throw Exception("no reply received for request");
 
@@ -515,7 +562,7 @@ void BatchedAffiliateAPIPGRetriever::transferJobFinished(TransferJob *j)
             throw Exception(j->errorString() + u'(' + QString::number(j->responseCode()) + u')');
         }
     } catch (const Exception &e) {
-        for (auto *pg : std::as_const(m_currentBatch)) {
+        for (auto *pg : std::as_const(currentBatch)) {
             if (pg) {
                 emit failed(pg, u"PG download for " + QChar::fromLatin1(pg->item()->itemType()->id())
                                     + u' ' + QString::fromLatin1(pg->item()->id()) + u" in "
@@ -525,8 +572,6 @@ void BatchedAffiliateAPIPGRetriever::transferJobFinished(TransferJob *j)
         }
     }
 
-    m_currentBatch.clear();
-
     QMetaObject::invokeMethod(this, &BatchedAffiliateAPIPGRetriever::check, Qt::QueuedConnection);
 }
 
@@ -564,6 +609,7 @@ PriceGuideCache::PriceGuideCache(Core *core)
     d->m_cacheStatId = AppStatistics::inst()->addSource(u"Price-guides in memory cache"_qs);
     d->m_loadsStatId = AppStatistics::inst()->addSource(u"Price-guides queued for disk load"_qs);
     d->m_savesStatId = AppStatistics::inst()->addSource(u"Price-guides queued for disk save"_qs);
+    d->m_diskSizeStatId = AppStatistics::inst()->addSource(u"Price-guide cache on disk"_qs, u"MB"_qs);
 
     d->m_cache.setMaxCost(5000); // each price guide has a cost of 1
 
@@ -601,6 +647,8 @@ PriceGuideCache::PriceGuideCache(Core *core)
     }
 
     if (d->m_db.isOpen()) {
+        DiskCache::enableIncrementalVacuum(d->m_db);
+
         QSqlQuery createQuery(d->m_db);
         if (!createQuery.exec(
                     u"CREATE TABLE IF NOT EXISTS pg ("
@@ -611,6 +659,10 @@ PriceGuideCache::PriceGuideCache(Core *core)
             qCWarning(LogSql) << "Failed to create the 'pg' table in the price-guide database:"
                        << createQuery.lastError().text();
             d->m_db.close();
+        } else if (!createQuery.exec(u"CREATE INDEX IF NOT EXISTS pg_accessed ON pg(accessed);"_qs)) {
+            // the eviction will be slower, but still works
+            qCWarning(LogSql) << "Failed to create the 'accessed' index in the price-guide database:"
+                              << createQuery.lastError().text();
         }
     }
 
@@ -672,6 +724,22 @@ void PriceGuideCache::setUpdateInterval(int interval)
     d->m_updateInterval = interval;
 }
 
+void PriceGuideCache::setMaxDiskSize(qint64 bytes)
+{
+    d->m_maxDiskSize = std::max<qint64>(0, bytes);
+
+    // the saver thread does the actual eviction
+    QMutexLocker locker(&d->m_saveMutex);
+    d->m_compactionNeeded = true;
+    d->m_saveTrigger.wakeAll();
+}
+
+void PriceGuideCache::setMaxConcurrentBatches(int count)
+{
+    if (auto batched = qobject_cast<BatchedAffiliateAPIPGRetriever *>(d->m_retriever))
+        batched->setMaxConcurrentBatches(count);
+}
+
 void PriceGuideCache::clearCache()
 {
     int lastLeftOver = 0;
@@ -719,31 +787,56 @@ PriceGuide *PriceGuideCache::priceGuide(const Item *item, const Color *color, Va
     if (!item || !color || !supportedVatTypes().contains(vatType))
         return nullptr;
 
-    auto key = PriceGuideCachePrivate::cacheKey(item, color, vatType);
-    PriceGuide *pg = d->m_cache[key];
+    bool needToLoad = false;
+    PriceGuide *pg = d->lookup(item, color, vatType, needToLoad);
 
-    bool needToLoad = !pg || (!pg->isValid() && (pg->updateStatus() == UpdateStatus::UpdateFailed));
-
-    if (!pg) {
-        pg = new PriceGuide(item, color, vatType);
-        if (!d->m_cache.insert(key, pg)) {
-            qCWarning(LogCache, "Can not add price guide to cache (cache max/cur: %d/%d, cost: %d)",
-                      int(d->m_cache.maxCost()), int(d->m_cache.totalCost()), 1);
-            return nullptr;
-        }
+    if (pg) {
         AppStatistics::inst()->update(d->m_cacheStatId, d->m_cache.count());
-    }
 
-    if (needToLoad) {
-        pg->setUpdateStatus(UpdateStatus::Loading);
-        d->load(pg, highPriority);
+        if (needToLoad)
+            d->load(pg, highPriority);
 
         //TODO re-prioritize?
     }
-
     return pg;
 }
 
+QVector<PriceGuide *> PriceGuideCache::priceGuides(const QVector<std::pair<const Item *, const Color *>> &itemsAndColors,
+                                                   bool highPriority)
+{
+    return priceGuides(itemsAndColors, currentVatType(), highPriority);
+}
+
+QVector<PriceGuide *> PriceGuideCache::priceGuides(const QVector<std::pair<const Item *, const Color *>> &itemsAndColors,
+                                                   VatType vatType, bool highPriority)
+{
+    QVector<PriceGuide *> result(itemsAndColors.size(), nullptr);
+    if (!supportedVatTypes().contains(vatType))
+        return result;
+
+    QVector<PriceGuide *> toLoad;
+
+    for (qsizetype i = 0; i < itemsAndColors.size(); ++i) {
+        const auto &[item, color] = itemsAndColors.at(i);
+        if (!item || !color)
+            continue;
+
+        bool needToLoad = false;
+        if (auto *pg = d->lookup(item, color, vatType, needToLoad)) {
+            // without a reference, the next insert could purge this one from the cache again
+            pg->addRef();
+            result[i] = pg;
+            if (needToLoad)
+                toLoad.append(pg);
+        }
+    }
+    AppStatistics::inst()->update(d->m_cacheStatId, d->m_cache.count());
+
+    // queue all of them at once: the loader threads will fetch them in batches
+    d->load(toLoad, highPriority);
+    return result;
+}
+
 void PriceGuideCache::updatePriceGuide(PriceGuide *pg, bool highPriority)
 {
     if (!pg || (pg->m_updateStatus == UpdateStatus::Updating))
@@ -865,16 +958,54 @@ bool PriceGuideCachePrivate::isUpdateNeeded(PriceGuide *pg) const
                 || (pg->lastUpdated().secsTo(QDateTime::currentDateTime()) > m_updateInterval));
 }
 
+PriceGuide *PriceGuideCachePrivate::lookup(const Item *item, const Color *color, VatType vatType,
+                                           bool &needToLoad)
+{
+    auto key = cacheKey(item, color, vatType);
+    PriceGuide *pg = m_cache[key];
+
+    needToLoad = !pg || (!pg->isValid() && (pg->updateStatus() == UpdateStatus::UpdateFailed));
+
+    if (!pg) {
+        pg = new PriceGuide(item, color, vatType);
+        if (!m_cache.insert(key, pg)) {
+            qCWarning(LogCache, "Can not add price guide to cache (cache max/cur: %d/%d, cost: %d)",
+                      int(m_cache.maxCost()), int(m_cache.totalCost()), 1);
+            needToLoad = false;
+            return nullptr;
+        }
+    }
+    if (needToLoad)
+        pg->setUpdateStatus(UpdateStatus::Loading);
+    return pg;
+}
+
 void PriceGuideCachePrivate::load(PriceGuide *pg, bool highPriority)
 {
     if (!pg)
         return;
 
-    pg->addRef();
+    load(QVector<PriceGuide *> { pg }, highPriority);
+}
+
+void PriceGuideCachePrivate::load(const QVector<PriceGuide *> &pgs, bool highPriority)
+{
+    if (pgs.isEmpty())
+        return;
+
+    QVector<std::pair<PriceGuide *, LoadType>> entries;
+    entries.reserve(pgs.size());
+    for (auto *pg : pgs) {
+        pg->addRef();
+        entries.append({ pg, highPriority ? LoadHighPriority : LoadLowPriority });
+    }
+
     m_loadMutex.lock();
-    m_loadQueue.insert(highPriority ? 0 : m_loadQueue.size(),
-                       { pg, highPriority ? LoadHighPriority : LoadLowPriority });
-    m_loadTrigger.wakeOne();
+    if (highPriority)
+        m_loadQueue = entries + m_loadQueue;
+    else
+        m_loadQueue.append(entries);
+    m_loadTrigger.wakeAll();
     auto queueSize = m_loadQueue.size();
     m_loadMutex.unlock();
 
@@ -901,8 +1032,22 @@ void PriceGuideCachePrivate::loadThread(QString dbName, int index)
     auto db = QSqlDatabase::cloneDatabase(dbName, dbName + u"_Reader_" + QString::number(index));
     db.open();
 
+    // We prepare a single statement for a full batch: unused placeholders are bound to NULL,
+    // which never matches an id.
+    QString placeholders = u"?"_qs;
+    for (int i = 1; i < MaxLoadBatchSize; ++i)
+        placeholders.append(u",?");
+
     QSqlQuery loadQuery(db);
-    loadQuery.prepare(u"SELECT updated,data FROM pg WHERE id=:id;"_qs);
+    loadQuery.prepare(u"SELECT id,updated,data FROM pg WHERE id IN (" + placeholders + u");");
+
+    struct LoadResult {
+        PriceGuide *pg;
+        bool highPriority;
+        bool loaded = false;
+        QDateTime lastUpdated = { };
+        QByteArray data = { };
+    };
 
     while (!m_stop) {
         QMutexLocker locker(&m_loadMutex);
@@ -915,64 +1060,96 @@ void PriceGuideCachePrivate::loadThread(QString dbName, int index)
             continue;
         }
 
-        // alternate between loading and saving in order to not starve one queue
         if (!m_loadQueue.isEmpty()) {
-            auto [pg, loadType] = m_loadQueue.takeFirst();
+            // the queue is sorted by priority, so the batch contains the most urgent requests
+            const auto batch = m_loadQueue.mid(0, MaxLoadBatchSize);
+            m_loadQueue.remove(0, batch.size());
             auto queueSize = m_loadQueue.size();
             locker.unlock();
 
             AppStatistics::inst()->update(m_loadsStatId, queueSize);
 
-            bool loaded = false;
-            QDateTime lastUpdated;
-            QByteArray data;
-            bool highPriority = (loadType == LoadHighPriority);
+            QVector<LoadResult> results;
+            QVector<QString> dbTags;
+            results.reserve(batch.size());
+            dbTags.reserve(batch.size());
+            for (const auto &[pg, loadType] : batch) {
+                results.append({ pg, (loadType == LoadHighPriority) });
+                dbTags.append(databaseTag(pg, m_retriever));
+            }
 
             if (db.isOpen()) {
-                loadQuery.bindValue(u":id"_qs, databaseTag(pg, m_retriever));
-
-                loadQuery.exec();
-                if (loadQuery.next()) {
-                    lastUpdated = loadQuery.isNull(0) ? QDateTime()
-                                                      : QDateTime::fromMSecsSinceEpoch(loadQuery.value(0).toLongLong());
-                    data = loadQuery.value(1).toByteArray();
-                    loaded = data.isEmpty() || (data.size() == sizeof(PriceGuide::Data));
+                for (int i = 0; i < MaxLoadBatchSize; ++i)
+                    loadQuery.bindValue(i, (i < dbTags.size()) ? QVariant(dbTags.at(i)) : QVariant(QMetaType::fromType<QString>()));
+
+                if (!loadQuery.exec()) {
+                    qCWarning(LogSql) << "Failed to load price guides:" << loadQuery.lastError().text();
+                } else {
+                    while (loadQuery.next()) {
+                        const auto i = dbTags.indexOf(loadQuery.value(0).toString());
+                        if ((i < 0) || results.at(i).loaded)
+                            continue;
+
+                        auto &result = results[i];
+                        result.lastUpdated = loadQuery.isNull(1) ? QDateTime()
+                                                                 : QDateTime::fromMSecsSinceEpoch(loadQuery.value(1).toLongLong());
+                        result.data = loadQuery.value(2).toByteArray();
+                        result.loaded = result.data.isEmpty() || (result.data.size() == sizeof(PriceGuide::Data));
+                    }
                 }
                 loadQuery.finish();
             }
-            pg->addRef(); // the release will happen on the main thread (see the invokeMethod below)
-            QMetaObject::invokeMethod(m_core, [=, this, pg=pg]() { // clang bug: P1091R3
-                if (loaded) {
-                    pg->setLastUpdated(lastUpdated);
-                    std::memcpy(&pg->m_data, data, sizeof(PriceGuide::Data));
-
-                    // update the last accessed time stamp
-                    pg->addRef();
+
+            // hand the whole batch over to the main thread in one go: our references are
+            // released over there
+            QMetaObject::invokeMethod(m_core, [this, results]() {
+                QVector<std::pair<PriceGuide *, SaveType>> accessed;
+
+                for (const auto &r : results) {
+                    if (r.loaded) {
+                        // update the last accessed time stamp
+                        r.pg->addRef();
+                        accessed.append({ r.pg, SaveAccessTimeOnly });
+                    }
+                }
+                if (!accessed.isEmpty()) {
                     m_saveMutex.lock();
-                    m_saveQueue.append({ pg, SaveAccessTimeOnly });
+                    m_saveQueue.append(accessed);
                     m_saveTrigger.wakeOne();
                     m_saveMutex.unlock();
                 }
-                pg->setIsValid(loaded);
-                pg->setUpdateStatus(UpdateStatus::Ok);
 
-                if (pg->m_updateAfterLoad || isUpdateNeeded(pg))  {
-                    pg->m_updateAfterLoad = false;
-                    q->updatePriceGuide(pg, highPriority);
+                for (const auto &r : results) {
+                    loadFinished(r.pg, r.highPriority, r.loaded, r.lastUpdated, r.data);
+                    r.pg->release();
                 }
-                if (loaded && data.isEmpty())
-                    pg->setIsValid(false);
-
-                emit q->priceGuideUpdated(pg);
-                pg->release();
             }, Qt::QueuedConnection);
-
-            pg->release();
         }
     }
     db.close();
 }
 
+void PriceGuideCachePrivate::loadFinished(PriceGuide *pg, bool highPriority, bool loaded,
+                                          const QDateTime &lastUpdated, const QByteArray &data)
+{
+    if (loaded) {
+        pg->setLastUpdated(lastUpdated);
+        if (data.size() == sizeof(PriceGuide::Data))
+            std::memcpy(&pg->m_data, data.constData(), sizeof(PriceGuide::Data));
+    }
+    pg->setIsValid(loaded);
+    pg->setUpdateStatus(UpdateStatus::Ok);
+
+    if (pg->m_updateAfterLoad || isUpdateNeeded(pg))  {
+        pg->m_updateAfterLoad = false;
+        q->updatePriceGuide(pg, highPriority);
+    }
+    if (loaded && data.isEmpty())
+        pg->setIsValid(false);
+
+    emit q->priceGuideUpdated(pg);
+}
+
 
 void PriceGuideCachePrivate::saveThread(QString dbName, int index)
 {
@@ -987,9 +1164,13 @@ void PriceGuideCachePrivate::saveThread(QString dbName, int index)
     QSqlQuery accessQuery(db);
     accessQuery.prepare(u"UPDATE pg SET accessed=:accessed WHERE id=:id;"_qs);
 
+    QElapsedTimer compactionTimer;
+    compactionTimer.start();
+
     while (!m_stop) {
         QMutexLocker locker(&m_saveMutex);
-        if (m_saveQueue.isEmpty())
+        // a pending compaction can only run on an open database
+        if (m_saveQueue.isEmpty() && (!m_compactionNeeded || !db.isOpen()))
             m_saveTrigger.wait(&m_saveMutex);
 
         if (!m_saveQueue.isEmpty()) {
@@ -1037,6 +1218,16 @@ void PriceGuideCachePrivate::saveThread(QString dbName, int index)
                 }
                 db.commit();
             }
+        } else {
+            locker.unlock();
+        }
+
+        // only saves can grow the database, so there is no need for a timer of its own
+        if (db.isOpen() && !m_stop && (m_compactionNeeded.testAndSetRelaxed(true, false)
+                                       || compactionTimer.hasExpired(CompactionInterval))) {
+            auto size = DiskCache::compact(db, u"pg"_qs, m_maxDiskSize.loadRelaxed());
+            AppStatistics::inst()->update(m_diskSizeStatId, size / 1'000'000);
+            compactionTimer.start();
         }
     }
     db.close();
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <QtCore/QDateTime>
+#include <QtCore/QVector>
 #include <QtQml/qqmlregistration.h>
 
 #include "bricklink/global.h"
@@ -105,6 +106,8 @@ public:
     ~PriceGuideCache() override;
 
     void setUpdateInterval(int interval);
+    void setMaxDiskSize(qint64 bytes);
+    void setMaxConcurrentBatches(int count); // only used by batching retrievers
     void clearCache();
     QPair<int, int> cacheStats() const;
 
@@ -112,6 +115,12 @@ public:
     PriceGuide *priceGuide(const Item *item, const Color *color, VatType vatType,
                            bool highPriority = false);
 
+    // one price guide per item/color pair, each with an added reference that needs to be released
+    QVector<PriceGuide *> priceGuides(const QVector<std::pair<const Item *, const Color *>> &itemsAndColors,
+                                      bool highPriority = false);
+    QVector<PriceGuide *> priceGuides(const QVector<std::pair<const Item *, const Color *>> &itemsAndColors,
+                                      VatType vatType, bool highPriority = false);
+
     void updatePriceGuide(PriceGuide *pg, bool highPriority = false);
     void cancelPriceGuideUpdate(PriceGuide *pg);
     void cancelAllPriceGuideUpdates();
@@ -5,6 +5,7 @@
 
 #include <QtCore/QElapsedTimer>
 #include <QtCore/QHash>
+#include <QtCore/QMap>
 #include <QtCore/QByteArray>
 #include <QtCore/QAtomicInt>
 #include <QtCore/QMutex>
@@ -87,24 +88,36 @@ public:
     void cancelAll() override;
 
     void setApiKey(const QString &key);
+    void setMaxConcurrentBatches(int count);
 
+    static constexpr qsizetype MinBatchSize = 50;
     static constexpr qsizetype MaxBatchSize = 500;
     static constexpr qint64 MaxBatchAgeMSec = 100;
+    static constexpr qint64 TargetBatchLatencyMSec = 3000;
+    static constexpr int DefaultMaxConcurrentBatches = 3; // Transfer only runs 6 jobs in parallel
 
 private:
+    struct Queue {
+        QVector<std::pair<PriceGuide *, QElapsedTimer>> entries;
+        qsizetype prioritySize = 0;
+    };
+    struct Batch {
+        TransferJob *job = nullptr;
+        QVector<PriceGuide *> priceGuides;
+        QElapsedTimer started;
+    };
+
     void check();
+    void startBatch(VatType vatType, Queue &queue);
     void transferJobFinished(TransferJob *j);
     static QString itemTypeApiId(const ItemType *itt);
 
     Core *m_core = nullptr;
-    QVector<PriceGuide *> m_currentBatch;
-    TransferJob *m_currentJob = nullptr;
-    QVector<std::pair<PriceGuide *, QElapsedTimer>> m_nextBatch;
-    VatType m_nextBatchVatType = VatType::Excluded;
-    qsizetype m_nextBatchPrioritySize = 0;
+    QMap<VatType, Queue> m_queues; // every VAT type needs separate batches
+    QVector<Batch> m_batches; // currently in flight
+    qsizetype m_batchSize = MaxBatchSize; // adapted to the observed latency
+    int m_maxConcurrentBatches = DefaultMaxConcurrentBatches;
     QTimer *m_batchTimer;
-    QVector<std::pair<PriceGuide *, QElapsedTimer>> m_wrongVatTypeQueue;
-    qsizetype m_wrongVatTypeQueuePrioritySize = 0;
     QString m_apiKey;
 };
 
@@ -135,7 +148,14 @@ public:
     QSqlDatabase m_db;
     QVector<QThread *> m_threads;
 
+    // the saver checks the on-disk size at most this often
+    static constexpr int CompactionInterval = 60 * 1000; // msec
+    // the loaders fetch this many price guides with a single SELECT (they are tiny)
+    static constexpr int MaxLoadBatchSize = 200;
+
     int m_updateInterval = 0;
+    QAtomicInteger<qint64> m_maxDiskSize = 0; // 0 means unlimited
+    QAtomicInt m_compactionNeeded = true;
     QMap<QString, VatType> m_vatType;  // key: retriever->id()
     Q3Cache<quint64, PriceGuide> m_cache;
     Core *m_core;
@@ -143,12 +163,17 @@ public:
     int m_cacheStatId = -1;
     int m_loadsStatId = -1;
     int m_savesStatId = -1;
+    int m_diskSizeStatId = -1;
 
     static quint64 cacheKey(const Item *item, const Color *color, VatType vatType);
     static QString databaseTag(PriceGuide *pg, PriceGuideRetrieverInterface *retriever);
     bool isUpdateNeeded(PriceGuide *pg) const;
 
+    PriceGuide *lookup(const Item *item, const Color *color, VatType vatType, bool &needToLoad);
     void load(PriceGuide *pg, bool highPriority);
+    void load(const QVector<PriceGuide *> &pgs, bool highPriority);
+    void loadFinished(PriceGuide *pg, bool highPriority, bool loaded, const QDateTime &lastUpdated,
+                      const QByteArray &data);
     void save(PriceGuide *pg);
     void loadThread(QString dbName, int index);
     void saveThread(QString dbName, int index);
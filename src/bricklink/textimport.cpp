@@ -15,10 +15,12 @@
 #include <QtCore/QtDebug>
 #include <QtCore/QDirIterator>
 #include <QtCore/QUrlQuery>
-#include <QtCore/QXmlStreamReader>
 
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <QCoro/QCoroFuture>
 #include <QCoro/QCoroSignal>
-#include <QCoro/QCoroTimer>
 
 #include "bricklink/changelogentry.h"
 #include "bricklink/core.h"
@@ -198,6 +200,9 @@ QCoro::Task<> TextImport::importCatalog()
     auto ldrawData = co_await download(ldrawUrl("library/official/LDConfig.ldr"), u"ldconfig.ldr"_qs);
     readLDrawColors(ldrawData, rebrickableData);
 
+    // the color lookups by name and LDraw id are used during the rest of the import
+    m_db->buildIndexes();
+
     co_await download(catalogQuery(2), u"categories.xml"_qs).then(
         [this](QByteArray data) { readCategories(data); });
 
@@ -206,9 +211,14 @@ QCoro::Task<> TextImport::importCatalog()
 
     m_db->m_items.reserve(200'000);
 
+    QVector<QByteArray> itemsXml;
+    for (const ItemType &itt : std::as_const(m_db->m_itemTypes))
+        itemsXml.append(co_await download(catalogItemQuery(itt.id(), true), u"items/%1.xml"_qs.arg(itt.id())));
+    readItems(itemsXml);
+    itemsXml.clear();
+
+    // the additional categories are merged into the sorted item list
     for (const ItemType &itt : std::as_const(m_db->m_itemTypes)) {
-        co_await download(catalogItemQuery(itt.id(), true), u"items/%1.xml"_qs.arg(itt.id())).then(
-            [this, &itt](QByteArray data) { readItems(data, &itt); });
         co_await download(catalogItemQuery(itt.id(), false), u"items/%1.csv"_qs.arg(itt.id())).then(
             [this, &itt](QByteArray data) { readAdditionalItemCategories(data, &itt); });
     }
@@ -256,32 +266,57 @@ QCoro::Task<> TextImport::importInventories()
 
     message(u"Loaded %1 inventories, %2 are missing or outdated"_qs.arg(loaded).arg(done.count(false)));
 
-    int downloadsInProgress = 0;
-    int downloadsFailed = 0;
+    QVector<const Item *> missing;
     for (uint i = 0; i < m_db->m_items.size(); ++i) {
-        const BrickLink::Item *item = &m_db->m_items[i];
-        if (!done[i]) {
+        if (!done[i])
+            missing.append(&m_db->m_items[i]);
+    }
+
+    // Keep a bounded number of downloads in flight and parse the finished ones in the thread
+    // pool in the meantime. Nothing is merged into the global data before all are done.
+    QVector<std::pair<const Item *, QFuture<ParsedInventory>>> parsing;
+    parsing.reserve(missing.size());
+    qsizetype nextMissing = 0;
+    int downloadsFailed = 0;
+
+    auto downloader = [&, this]() -> QCoro::Task<> {
+        while (nextMissing < missing.size()) {
+            const Item *item = missing.at(nextMissing++);
             const QString filePath = u"%1/%2.xml"_qs.arg(item->itemTypeId()).arg(QLatin1StringView(item->id()));
-            ++downloadsInProgress;
-            download(itemInventoryQuery(item), filePath).then(
-                [&, item](QByteArray data) {
-                    if (!readInventory(item->itemTypeId(), item->id(), QDateTime::currentDateTime(), data)) {
-                        message(2, u"Failed to import downloaded inventory for %1 %2"_qs
-                                       .arg(item->itemTypeId()).arg(QLatin1StringView(item->id())));
-                        ++downloadsFailed;
-                    }
-                    --downloadsInProgress;
-                },
-                [&](const std::exception &e) {
-                    message(2, QString::fromLatin1(e.what()));
-                    --downloadsInProgress;
-                    ++downloadsFailed;
-                });
+            try {
+                const QByteArray data = co_await download(itemInventoryQuery(item), filePath);
+                parsing.append({ item, QtConcurrent::run([this, item, data]() {
+                    return parseInventory(item->itemTypeId(), item->id(), QDateTime::currentDateTime(), data);
+                }) });
+            } catch (const std::exception &e) {
+                message(2, QString::fromLatin1(e.what()));
+                ++downloadsFailed;
+            }
         }
-    }
+    };
 
-    while (downloadsInProgress)
-        co_await QCoro::sleepFor(std::chrono::milliseconds(100));
+    std::vector<QCoro::Task<>> downloaders;
+    for (int i = 0; i < MaxConcurrentInventoryDownloads; ++i)
+        downloaders.push_back(downloader());
+    for (auto &task : downloaders)
+        co_await task;
+
+    // merge in item order, so that the result doesn't depend on the download order
+    std::sort(parsing.begin(), parsing.end(), [](const auto &p1, const auto &p2) {
+        return p1.first->index() < p2.first->index();
+    });
+    for (auto &[item, future] : parsing) {
+        const ParsedInventory parsed = co_await future;
+        if (parsed.item) {
+            addInventory(parsed);
+        } else {
+            message(2, u"Failed to import downloaded inventory for %1 %2"_qs
+                           .arg(item->itemTypeId()).arg(QLatin1StringView(item->id())));
+            if (!parsed.error.isEmpty())
+                message(2, parsed.error);
+            ++downloadsFailed;
+        }
+    }
 
     if (downloadsFailed)
         throw Exception("Failed to download %1 inventories").arg(downloadsFailed);
@@ -346,6 +381,8 @@ void TextImport::finalize()
         item.m_appears_in.copyContainer(tmp.cbegin(), tmp.cend(), nullptr);
     }
 
+    m_db->buildIndexes();
+
     m_db->m_lastUpdated = QDateTime::currentDateTime();
     message(0, m_db->dumpDatabaseInformation({ }, true, true));
 }
@@ -359,10 +396,40 @@ void TextImport::exportDatabase()
 
     Q_ASSERT(dbVersionHighest >= dbVersionLowest);
 
+    const QString latestFileName = core()->dataPath() + Database::defaultDatabaseName(dbVersionHighest);
+    QByteArray previousLatest;
+    QFile previousFile(latestFileName);
+    if (previousFile.open(QIODevice::ReadOnly)) {
+        previousLatest = previousFile.readAll();
+        previousFile.close();
+    }
+
     for (auto v = dbVersionHighest; v >= dbVersionLowest; v = Database::Version((int(v) - 1))) {
         message(u"Version v%1"_qs.arg(int(v)));
         core()->database()->write(core()->dataPath() + Database::defaultDatabaseName(v), v);
     }
+
+    // clients with the previous version of the latest database only need the changed chunks.
+    // A delta is always written, because a stale one left on the server would make clients
+    // believe that they are up-to-date: without a base it just tells them to fetch everything.
+    const QString deltaFileName = latestFileName + u".delta";
+
+    QFile latestFile(latestFileName);
+    if (!latestFile.open(QIODevice::ReadOnly))
+        throw Exception(&latestFile, "could not open database for reading");
+
+    const QByteArray delta = Database::createDelta(previousLatest, latestFile.readAll());
+
+    QFile deltaFile(deltaFileName);
+    if (!deltaFile.open(QIODevice::WriteOnly | QIODevice::Truncate) || (deltaFile.write(delta) != delta.size()))
+        throw Exception(&deltaFile, "could not write the database delta");
+
+    if (previousLatest.isEmpty()) {
+        message(u"No previous v%1 database: the delta forces a full download"_qs.arg(int(dbVersionHighest)));
+    } else {
+        message(u"Delta to the previous v%1: %2 of %3 bytes"_qs.arg(int(dbVersionHighest))
+                    .arg(delta.size()).arg(latestFile.size()));
+    }
 }
 
 void TextImport::setApiKeys(const QHash<QByteArray, QString> &apiKeys)
@@ -410,34 +477,39 @@ QCoro::Task<QByteArray> TextImport::download(const QUrl &url, const QString &fil
 
 void TextImport::readColors(const QByteArray &xml)
 {
-    xmlParse(xml, u"CATALOG", u"ITEM", [this](const auto &e) {
+    enum { ColorId, ColorName, ColorRgb, ColorTypeName, PartCount, SetCount, WantedCount, ForSaleCount,
+           YearFrom, YearTo };
+
+    xmlParse(xml, "CATALOG", "ITEM", { "COLOR", "COLORNAME", "COLORRGB", "COLORTYPE", "COLORCNTPARTS",
+                                       "COLORCNTSETS", "COLORCNTWANTED", "COLORCNTINV", "COLORYEARFROM",
+                                       "COLORYEARTO" }, [this](const XmlElement &e) {
         Color col;
-        uint colid = xmlTagText(e, u"COLOR").toUInt();
+        uint colid = e.raw(ColorId).toUInt();
 
         col.m_id       = colid;
-        col.m_name.copyQString(xmlTagText(e, u"COLORNAME").simplified(), nullptr);
-        col.m_color    = QColor(u'#' + xmlTagText(e, u"COLORRGB"));
+        col.m_name.copyQString(e.text(ColorName).simplified(), nullptr);
+        col.m_color    = QColor(u'#' + e.text(ColorRgb));
 
         col.m_ldraw_id = -1;
         col.m_type     = ColorType();
 
-        auto type = xmlTagText(e, u"COLORTYPE");
-        if (type.contains(u"Transparent")) col.m_type |= ColorTypeFlag::Transparent;
-        if (type.contains(u"Glitter"))     col.m_type |= ColorTypeFlag::Glitter;
-        if (type.contains(u"Speckle"))     col.m_type |= ColorTypeFlag::Speckle;
-        if (type.contains(u"Metallic"))    col.m_type |= ColorTypeFlag::Metallic;
-        if (type.contains(u"Chrome"))      col.m_type |= ColorTypeFlag::Chrome;
-        if (type.contains(u"Pearl"))       col.m_type |= ColorTypeFlag::Pearl;
-        if (type.contains(u"Milky"))       col.m_type |= ColorTypeFlag::Milky;
-        if (type.contains(u"Modulex"))     col.m_type |= ColorTypeFlag::Modulex;
-        if (type.contains(u"Satin"))       col.m_type |= ColorTypeFlag::Satin;
+        const auto type = e.raw(ColorTypeName);
+        if (type.contains("Transparent")) col.m_type |= ColorTypeFlag::Transparent;
+        if (type.contains("Glitter"))     col.m_type |= ColorTypeFlag::Glitter;
+        if (type.contains("Speckle"))     col.m_type |= ColorTypeFlag::Speckle;
+        if (type.contains("Metallic"))    col.m_type |= ColorTypeFlag::Metallic;
+        if (type.contains("Chrome"))      col.m_type |= ColorTypeFlag::Chrome;
+        if (type.contains("Pearl"))       col.m_type |= ColorTypeFlag::Pearl;
+        if (type.contains("Milky"))       col.m_type |= ColorTypeFlag::Milky;
+        if (type.contains("Modulex"))     col.m_type |= ColorTypeFlag::Modulex;
+        if (type.contains("Satin"))       col.m_type |= ColorTypeFlag::Satin;
         if (!col.m_type)
             col.m_type = ColorTypeFlag::Solid;
 
-        int partCnt    = xmlTagText(e, u"COLORCNTPARTS").toInt();
-        int setCnt     = xmlTagText(e, u"COLORCNTSETS").toInt();
-        int wantedCnt  = xmlTagText(e, u"COLORCNTWANTED").toInt();
-        int forSaleCnt = xmlTagText(e, u"COLORCNTINV").toInt();
+        int partCnt    = e.raw(PartCount).toInt();
+        int setCnt     = e.raw(SetCount).toInt();
+        int wantedCnt  = e.raw(WantedCount).toInt();
+        int forSaleCnt = e.raw(ForSaleCount).toInt();
 
         col.m_popularity = float(partCnt + setCnt + wantedCnt + forSaleCnt);
 
@@ -445,8 +517,8 @@ void TextImport::readColors(const QByteArray &xml)
         // mark it as raw data meanwhile:
         col.m_popularity = -col.m_popularity;
 
-        col.m_year_from = xmlTagText(e, u"COLORYEARFROM").toUShort();
-        col.m_year_to   = xmlTagText(e, u"COLORYEARTO").toUShort();
+        col.m_year_from = e.raw(YearFrom).toUShort();
+        col.m_year_to   = e.raw(YearTo).toUShort();
 
         m_db->m_colors.push_back(col);
     });
@@ -456,12 +528,14 @@ void TextImport::readColors(const QByteArray &xml)
 
 void TextImport::readCategories(const QByteArray &xml)
 {
-    xmlParse(xml, u"CATALOG", u"ITEM", [this](const auto &e) {
+    enum { CategoryId, CategoryName };
+
+    xmlParse(xml, "CATALOG", "ITEM", { "CATEGORY", "CATEGORYNAME" }, [this](const XmlElement &e) {
         Category cat;
-        uint catid = xmlTagText(e, u"CATEGORY").toUInt();
+        uint catid = e.raw(CategoryId).toUInt();
 
         cat.m_id   = catid;
-        cat.m_name.copyQString(xmlTagText(e, u"CATEGORYNAME").simplified(), nullptr);
+        cat.m_name.copyQString(e.text(CategoryName).simplified(), nullptr);
 
         m_db->m_categories.push_back(cat);
     });
@@ -471,15 +545,17 @@ void TextImport::readCategories(const QByteArray &xml)
 
 void TextImport::readItemTypes(const QByteArray &xml)
 {
-    xmlParse(xml, u"CATALOG", u"ITEM", [this](const auto &e) {
+    enum { ItemTypeId, ItemTypeName };
+
+    xmlParse(xml, "CATALOG", "ITEM", { "ITEMTYPE", "ITEMTYPENAME" }, [this](const XmlElement &e) {
         ItemType itt;
-        char c = ItemType::idFromFirstCharInString(xmlTagText(e, u"ITEMTYPE"));
+        char c = ItemType::idFromFirstCharInString(e.text(ItemTypeId));
 
         if (c == 'U')
             return;
 
         itt.m_id   = c;
-        itt.m_name.copyQString(xmlTagText(e, u"ITEMTYPENAME").simplified(), nullptr);
+        itt.m_name.copyQString(e.text(ItemTypeName).simplified(), nullptr);
 
         itt.m_has_inventories   = false;
         itt.m_has_colors        = (c == 'P' || c == 'G');
@@ -492,36 +568,76 @@ void TextImport::readItemTypes(const QByteArray &xml)
     std::sort(m_db->m_itemTypes.begin(), m_db->m_itemTypes.end());
 }
 
-void TextImport::readItems(const QByteArray &xml, const ItemType *itt)
+void TextImport::readItems(const QVector<QByteArray> &xmls)
 {
-    xmlParse(xml, u"CATALOG", u"ITEM", [this, itt](const auto &e) {
+    Q_ASSERT(xmls.size() == qsizetype(m_db->m_itemTypes.size()));
+
+    // the item types are independent of each other, so they can be parsed in parallel
+    struct ParseJob {
+        const QByteArray *xml;
+        const ItemType *itt;
+        std::vector<Item> items;
+        std::exception_ptr error;
+    };
+    std::vector<ParseJob> jobs;
+    jobs.reserve(size_t(xmls.size()));
+    for (qsizetype i = 0; i < xmls.size(); ++i)
+        jobs.push_back({ &xmls.at(i), &m_db->m_itemTypes.at(size_t(i)), { }, { } });
+
+    QtConcurrent::blockingMap(jobs, [this](ParseJob &job) {
+        try {
+            job.items = parseItems(*job.xml, job.itt);
+        } catch (...) {
+            job.error = std::current_exception();
+        }
+    });
+
+    for (auto &job : jobs) {
+        if (job.error)
+            std::rethrow_exception(job.error);
+        m_db->m_items.insert(m_db->m_items.end(), std::make_move_iterator(job.items.begin()),
+                             std::make_move_iterator(job.items.end()));
+    }
+
+    std::sort(m_db->m_items.begin(), m_db->m_items.end());
+}
+
+// this is called from multiple threads at once: only read global data
+std::vector<Item> TextImport::parseItems(const QByteArray &xml, const ItemType *itt) const
+{
+    enum { ItemId, ItemName, CategoryId, AltItemIds, ItemYear, ItemWeight, ImageColor };
+
+    std::vector<Item> items;
+
+    xmlParse(xml, "CATALOG", "ITEM", { "ITEMID", "ITEMNAME", "CATEGORY", "ALTITEMIDS", "ITEMYEAR",
+                                       "ITEMWEIGHT", "IMAGECOLOR" }, [this, itt, &items](const XmlElement &e) {
         Item item;
-        item.m_id.copyQByteArray(xmlTagText(e, u"ITEMID").toLatin1(), nullptr);
-        const QString itemName = xmlTagText(e, u"ITEMNAME").simplified();
+        item.m_id.copyQByteArray(e.latin1(ItemId), nullptr);
+        const QString itemName = e.text(ItemName).simplified();
         item.m_name.copyQString(itemName, nullptr);
         item.m_itemTypeIndex = quint16(itt - m_db->m_itemTypes.data());
 
-        uint catId = xmlTagText(e, u"CATEGORY").toUInt();
+        uint catId = e.raw(CategoryId).toUInt();
         auto cat = core()->category(catId);
         if (!cat)
             throw ParseException("item %1 has no category").arg(QString::fromLatin1(item.id()));
         item.m_categoryIndexes.push_back(quint16(cat->index()), nullptr);
 
-        QByteArray altIds = xmlTagText(e, u"ALTITEMIDS", true).toLatin1().replace(',', ' ').simplified();
+        QByteArray altIds = e.latin1(AltItemIds, true).replace(',', ' ').simplified();
         if (!altIds.isEmpty())
             item.m_alternateIds.copyQByteArray(altIds, nullptr);
 
-        uint y = xmlTagText(e, u"ITEMYEAR", true).toUInt();
+        uint y = e.raw(ItemYear, true).toUInt();
         item.m_year_from = quint8(((y > 1900) && (y < 2155)) ? (y - 1900) : 0); // we only have 8 bits for the year
         item.m_year_to = item.m_year_from;
 
         if (itt->hasWeight())
-            item.m_weight = xmlTagText(e, u"ITEMWEIGHT").toFloat();
+            item.m_weight = e.raw(ItemWeight).toFloat();
         else
             item.m_weight = 0;
 
         try {
-            auto color = core()->color(xmlTagText(e, u"IMAGECOLOR").toUInt());
+            auto color = core()->color(e.raw(ImageColor).toUInt());
             item.m_defaultColorIndex = !color ? quint16(0xfff) : quint16(color->index());
         } catch (...) {
             item.m_defaultColorIndex = quint16(0xfff);
@@ -542,10 +658,9 @@ void TextImport::readItems(const QByteArray &xml, const ItemType *itt)
                 item.m_dimensions.copyContainer(dims.cbegin(), dims.cend(), nullptr);
         }
 
-        m_db->m_items.push_back(item);
+        items.push_back(item);
     });
-
-    std::sort(m_db->m_items.begin(), m_db->m_items.end());
+    return items;
 }
 
 void TextImport::readAdditionalItemCategories(const QByteArray &csv, const ItemType *itt)
@@ -624,12 +739,15 @@ void TextImport::readPartColorCodes(const QByteArray &xml)
 {
     QHash<uint, QVector<Item::PCC>> pccs;
 
-    xmlParse(xml, u"CODES", u"ITEM", [this, &pccs](const auto &e) {
-        char itemTypeId = ItemType::idFromFirstCharInString(xmlTagText(e, u"ITEMTYPE"));
-        const QByteArray itemId = xmlTagText(e, u"ITEMID").toLatin1();
-        QString colorName = xmlTagText(e, u"COLOR").simplified();
+    enum { ItemTypeId, ItemId, ColorName, CodeName };
+
+    xmlParse(xml, "CODES", "ITEM", { "ITEMTYPE", "ITEMID", "COLOR", "CODENAME" },
+             [this, &pccs](const XmlElement &e) {
+        char itemTypeId = ItemType::idFromFirstCharInString(e.text(ItemTypeId));
+        const QByteArray itemId = e.latin1(ItemId);
+        QString colorName = e.text(ColorName).simplified();
         bool numeric = false;
-        uint code = xmlTagText(e, u"CODENAME").toUInt(&numeric, 10);
+        uint code = e.raw(CodeName).toUInt(&numeric, 10);
 
         if (auto item = core()->item(itemTypeId, itemId)) {
             bool noColor = !core()->itemType(itemTypeId)->hasColors();
@@ -652,7 +770,7 @@ void TextImport::readPartColorCodes(const QByteArray &xml)
                     pccs[itemIndex].push_back(pcc);
                 } else {
                     message(2, u"Parsing part_color_codes: pcc %1 is not numeric"_qs
-                                   .arg(xmlTagText(e, u"CODENAME")));
+                                   .arg(e.text(CodeName)));
                 }
             } else {
                 message(2, u"Parsing part_color_codes: skipping invalid color %1 on item %2 %3"_qs
@@ -678,31 +796,51 @@ const Item *TextImport::readInventory(char itemTypeId, const QByteArray &itemId,
                                       const QDateTime &lastModified, const QByteArray &xml,
                                       bool failSilently)
 {
+    const auto parsed = parseInventory(itemTypeId, itemId, lastModified, xml);
+    if (!parsed.item) {
+        if (!failSilently && !parsed.error.isEmpty())
+            message(2, parsed.error);
+        return nullptr;
+    }
+    addInventory(parsed);
+    return parsed.item;
+}
+
+// this is called from multiple threads at once: only read global data
+TextImport::ParsedInventory TextImport::parseInventory(char itemTypeId, const QByteArray &itemId,
+                                                       const QDateTime &lastModified,
+                                                       const QByteArray &xml) const
+{
+    ParsedInventory result;
+
     const auto *invItem = core()->item(itemTypeId, itemId);
     if (!invItem)
-        return nullptr; // no item found
+        return result; // no item found
     qint64 lastUpdated =  m_inventoryLastUpdated.value(invItem->index(), -1);
     if (lastUpdated < 0)
-        return nullptr; // item found, but does not have an inventory
+        return result; // item found, but does not have an inventory
     if (lastModified.toSecsSinceEpoch() < lastUpdated)
-        return nullptr; // item found, has an inventory, but is outdated
+        return result; // item found, has an inventory, but is outdated
 
     QDate lastModifiedDate = lastModified.date();
 
     QVector<Item::ConsistsOf> inventory;
     QVector<QPair<uint, uint>> knownColors;
 
+    enum { ItemTypeId, ItemId, ColorId, Quantity, Extra, CounterPart, Alternate, MatchId };
+
     try {
-        xmlParse(xml, u"INVENTORY", u"ITEM",
-                 [this, &inventory, &knownColors, lastModifiedDate](const auto &e) {
-            char itemTypeId = ItemType::idFromFirstCharInString(xmlTagText(e, u"ITEMTYPE"));
-            const QByteArray itemId = xmlTagText(e, u"ITEMID").toLatin1();
-            uint colorId = xmlTagText(e, u"COLOR").toUInt();
-            uint qty = xmlTagText(e, u"QTY").toUInt();
-            bool extra = (xmlTagText(e, u"EXTRA") == u"Y");
-            bool counterPart = (xmlTagText(e, u"COUNTERPART") == u"Y");
-            bool alternate = (xmlTagText(e, u"ALTERNATE") == u"Y");
-            uint matchId = xmlTagText(e, u"MATCHID").toUInt();
+        xmlParse(xml, "INVENTORY", "ITEM", { "ITEMTYPE", "ITEMID", "COLOR", "QTY", "EXTRA", "COUNTERPART",
+                                             "ALTERNATE", "MATCHID" },
+                 [this, &inventory, &knownColors, lastModifiedDate](const XmlElement &e) {
+            char itemTypeId = ItemType::idFromFirstCharInString(e.text(ItemTypeId));
+            const QByteArray itemId = e.latin1(ItemId);
+            uint colorId = e.raw(ColorId).toUInt();
+            uint qty = e.raw(Quantity).toUInt();
+            bool extra = (e.raw(Extra) == "Y");
+            bool counterPart = (e.raw(CounterPart) == "Y");
+            bool alternate = (e.raw(Alternate) == "Y");
+            uint matchId = e.raw(MatchId).toUInt();
 
             auto item = core()->item(itemTypeId, itemId);
             auto color = core()->color(colorId);
@@ -753,11 +891,6 @@ const Item *TextImport::readInventory(char itemTypeId, const QByteArray &itemId,
 
         });
 
-        // no more throwing beyond this point, as we cannot undo changes to global data
-
-        for (const auto &kc : std::as_const(knownColors))
-            addToKnownColors(kc.first, kc.second);
-
         // BL bug: if an extra item is part of an alternative match set, then none of the
         //         alternatives have the 'extra' flag set.
         for (Item::ConsistsOf &co : inventory) {
@@ -784,21 +917,31 @@ const Item *TextImport::readInventory(char itemTypeId, const QByteArray &itemId,
                 return co1.itemIndex() < co2.itemIndex();
         });
 
-        for (const Item::ConsistsOf &co : std::as_const(inventory)) {
-            if (!co.isExtra()) {
-                auto &vec = m_appears_in_hash[co.itemIndex()][co.colorIndex()];
-                vec.append(qMakePair(co.quantity(), invItem->index()));
-            }
-        }
-        // the hash owns the items now
-        m_consists_of_hash.insert(invItem->index(), inventory);
-        return invItem;
+        result.item = invItem;
+        result.inventory = inventory;
+        result.knownColors = knownColors;
 
     } catch (const Exception &e) {
-        if (!failSilently)
-            message(2, e.errorString());
-        return nullptr;
+        result.error = e.errorString();
+    }
+    return result;
+}
+
+void TextImport::addInventory(const ParsedInventory &parsed)
+{
+    // no more throwing beyond this point, as we cannot undo changes to global data
+
+    for (const auto &kc : parsed.knownColors)
+        addToKnownColors(kc.first, kc.second);
+
+    for (const Item::ConsistsOf &co : parsed.inventory) {
+        if (!co.isExtra()) {
+            auto &vec = m_appears_in_hash[co.itemIndex()][co.colorIndex()];
+            vec.append(qMakePair(co.quantity(), parsed.item->index()));
+        }
     }
+    // the hash owns the items now
+    m_consists_of_hash.insert(parsed.item->index(), parsed.inventory);
 }
 
 void TextImport::readLDrawColors(const QByteArray &ldconfig, const QByteArray &rebrickableColors)
@@ -1521,9 +1664,30 @@ uint TextImport::loadLastRunInventories(const std::function<void(char, const QBy
 
 void TextImport::nextStep(const QString &text)
 {
+    if (!m_stepTimings.isEmpty())
+        m_stepTimings.last().second = m_stepTimer.restart();
+    else
+        m_stepTimer.start();
+    m_stepTimings.append({ text, -1 });
+
     printf("\nSTEP %d: %s\n", ++m_currentStep, qPrintable(text));
 }
 
+void TextImport::printTimings()
+{
+    if (m_stepTimings.isEmpty())
+        return;
+    m_stepTimings.last().second = m_stepTimer.restart();
+
+    printf("\nTimings:\n");
+    qint64 total = 0;
+    for (const auto &[step, msec] : std::as_const(m_stepTimings)) {
+        printf("  %8.1fs  %s\n", double(msec) / 1000, qPrintable(step));
+        total += msec;
+    }
+    printf("  %8.1fs  total\n", double(total) / 1000);
+}
+
 void TextImport::message(const QString &text)
 {
     message(1, text);
@@ -1537,43 +1701,201 @@ void TextImport::message(int level, const QString &text)
         printf("%s%c %s\n", QByteArray(level * 2, ' ').constData(), (level <= 1) ? '*' : '>', qPrintable(text));
 }
 
-void TextImport::xmlParse(const QByteArray &xml, QStringView rootName, QStringView elementName,
-                          const std::function<void (const QHash<QString, QString> &)> &callback)
+void TextImport::xmlParse(const QByteArray &xml, QByteArrayView rootName, QByteArrayView elementName,
+                          std::initializer_list<QByteArrayView> tagNames,
+                          const std::function<void (const XmlElement &)> &callback)
 {
-    // Bricklink double encodes entities, so instead of "&#40;", we get "&amp;#40;"
-    const QByteArray fixedXml = core()->isApiQuirkActive(ApiQuirk::CatalogDownloadEntitiesAreDoubleEscaped)
-                                    ? QByteArray(xml).replace("&amp;#", "&#")
-                                    : xml;
-
-    QXmlStreamReader xsr(fixedXml);
-    if (xsr.readNextStartElement()) {
-        if (xsr.name() != rootName)
-            throw Exception("expected XML root node %1, but got %2").arg(rootName, xsr.name());
-        while (xsr.readNextStartElement()) {
-            if (xsr.name() != elementName)
-                throw Exception("expected XML element node %1, but got %2").arg(elementName, xsr.name());
-
-            QHash<QString, QString> hash;
-            while (xsr.readNextStartElement())
-                hash.insert(xsr.name().toString(), xsr.readElementText().trimmed());
-            callback(hash);
+    // The catalog files are huge, but very simple: a root node with a flat list of records, each
+    // consisting of text-only child tags. Scanning them directly is a lot faster than going
+    // through QXmlStreamReader and copying every field into a hash.
+
+    Q_ASSERT(tagNames.size() <= XmlElement::MaxTags);
+
+    const QByteArrayView doc(xml);
+    qsizetype pos = 0;
+
+    auto error = [&](const QString &what) {
+        return Exception("Error parsing XML at offset %1: %2").arg(pos).arg(what);
+    };
+
+    struct Tag {
+        QByteArrayView name;
+        bool isEnd = false;
+        bool isEmpty = false; // <TAG/>
+    };
+
+    // skips text, comments, processing instructions and DTDs up to the next tag
+    auto nextTag = [&]() -> Tag {
+        while (true) {
+            pos = doc.indexOf('<', pos);
+            if (pos < 0) {
+                pos = doc.size();
+                throw error(u"premature end of document"_qs);
+            }
+            const auto rest = doc.sliced(pos);
+            qsizetype skipTo = -1;
+            if (rest.startsWith("<?"))
+                skipTo = doc.indexOf("?>", pos);
+            else if (rest.startsWith("<!--"))
+                skipTo = doc.indexOf("-->", pos);
+            else if (rest.startsWith("<!"))
+                skipTo = doc.indexOf('>', pos);
+            else
+                break;
+            if (skipTo < 0)
+                throw error(u"unterminated markup declaration"_qs);
+            pos = skipTo + 1;
+        }
+        Tag tag;
+        ++pos;
+        if ((pos < doc.size()) && (doc.at(pos) == '/')) {
+            tag.isEnd = true;
+            ++pos;
+        }
+        const qsizetype nameStart = pos;
+        while ((pos < doc.size()) && !QChar::isSpace(uchar(doc.at(pos)))
+               && (doc.at(pos) != '/') && (doc.at(pos) != '>')) {
+            ++pos;
+        }
+        tag.name = doc.sliced(nameStart, pos - nameStart);
+        const qsizetype tagEnd = doc.indexOf('>', pos);
+        if (tag.name.isEmpty() || (tagEnd < 0))
+            throw error(u"malformed tag"_qs);
+        tag.isEmpty = !tag.isEnd && (doc.at(tagEnd - 1) == '/');
+        pos = tagEnd + 1;
+        return tag;
+    };
+
+    auto expectEndTag = [&](QByteArrayView name) {
+        const Tag tag = nextTag();
+        if (!tag.isEnd || (tag.name != name)) {
+            throw error(u"expected the closing tag of %1, but got %2"_qs
+                            .arg(QLatin1StringView(name), QLatin1StringView(tag.name)));
         }
+    };
+
+    XmlElement element;
+    element.m_tagNames = tagNames.begin();
+    // Bricklink double encodes entities, so instead of "&#40;", we get "&amp;#40;"
+    element.m_doubleEscaped = core()->isApiQuirkActive(ApiQuirk::CatalogDownloadEntitiesAreDoubleEscaped);
+
+    const Tag root = nextTag();
+    if (root.isEnd || (root.name != rootName)) {
+        throw Exception("expected XML root node %1, but got %2")
+            .arg(QLatin1StringView(rootName), QLatin1StringView(root.name));
     }
+    if (root.isEmpty)
+        return;
 
-    if (xsr.hasError())
-        throw Exception("Error parsing XML: %1").arg(xsr.errorString());
+    while (true) {
+        const Tag record = nextTag();
+        if (record.isEnd) {
+            if (record.name != rootName)
+                throw error(u"unexpected closing tag %1"_qs.arg(QLatin1StringView(record.name)));
+            break;
+        }
+        if (record.name != elementName) {
+            throw Exception("expected XML element node %1, but got %2")
+                .arg(QLatin1StringView(elementName), QLatin1StringView(record.name));
+        }
+
+        element.m_present = 0;
+
+        while (!record.isEmpty) {
+            const Tag field = nextTag();
+            if (field.isEnd) {
+                if (field.name != elementName)
+                    throw error(u"unexpected closing tag %1"_qs.arg(QLatin1StringView(field.name)));
+                break;
+            }
+
+            QByteArrayView value = doc.sliced(pos, 0);
+            if (!field.isEmpty) {
+                const qsizetype textEnd = doc.indexOf('<', pos);
+                if (textEnd < 0)
+                    throw error(u"premature end of document"_qs);
+                value = doc.sliced(pos, textEnd - pos).trimmed();
+                pos = textEnd;
+                expectEndTag(field.name);
+            }
+
+            const auto it = std::find(tagNames.begin(), tagNames.end(), field.name);
+            if (it != tagNames.end()) {
+                const auto tag = std::distance(tagNames.begin(), it);
+                element.m_values[size_t(tag)] = value;
+                element.m_present |= (1u << tag);
+            }
+        }
+        callback(element);
+    }
 }
 
-QString TextImport::xmlTagText(const QHash<QString, QString> &element, QStringView tagName,
-                               bool optional)
+QByteArrayView TextImport::XmlElement::raw(int tag, bool optional) const
 {
-    auto it = element.constFind(tagName.toString());
-    if (it != element.constEnd())
-        return it.value();
+    Q_ASSERT((tag >= 0) && (tag < MaxTags));
+
+    if (m_present & (1u << tag))
+        return m_values[size_t(tag)];
     else if (optional)
         return { };
     else
-        throw Exception("Expected a <%1> tag, but couldn't find one").arg(tagName);
+        throw Exception("Expected a <%1> tag, but couldn't find one").arg(QLatin1StringView(m_tagNames[tag]));
+}
+
+QString TextImport::XmlElement::text(int tag, bool optional) const
+{
+    const QByteArrayView value = raw(tag, optional);
+
+    qsizetype amp = value.indexOf('&');
+    if (amp < 0)
+        return QString::fromUtf8(value);
+
+    QString str;
+    str.reserve(value.size());
+    qsizetype pos = 0;
+
+    while (amp >= 0) {
+        str.append(QString::fromUtf8(value.sliced(pos, amp - pos)));
+
+        qsizetype entityStart = amp + 1;
+        if (m_doubleEscaped && value.sliced(entityStart).startsWith("amp;#"))
+            entityStart += 4;
+        const qsizetype entityEnd = value.indexOf(';', entityStart);
+        if (entityEnd < 0)
+            throw Exception("Unterminated XML entity in %1").arg(QString::fromUtf8(value));
+        const QByteArrayView entity = value.sliced(entityStart, entityEnd - entityStart);
+
+        if (entity == "amp") {
+            str.append(u'&');
+        } else if (entity == "lt") {
+            str.append(u'<');
+        } else if (entity == "gt") {
+            str.append(u'>');
+        } else if (entity == "quot") {
+            str.append(u'"');
+        } else if (entity == "apos") {
+            str.append(u'\'');
+        } else if (entity.startsWith('#')) {
+            bool ok = false;
+            const char32_t ucs4 = entity.startsWith("#x") ? entity.sliced(2).toUInt(&ok, 16)
+                                                          : entity.sliced(1).toUInt(&ok, 10);
+            if (!ok || !ucs4 || (ucs4 > QChar::LastValidCodePoint))
+                throw Exception("Invalid XML character reference &%1;").arg(QLatin1StringView(entity));
+            str.append(QChar::fromUcs4(ucs4));
+        } else {
+            throw Exception("Unknown XML entity &%1;").arg(QLatin1StringView(entity));
+        }
+        pos = entityEnd + 1;
+        amp = value.indexOf('&', pos);
+    }
+    str.append(QString::fromUtf8(value.sliced(pos)));
+    return str;
+}
+
+QByteArray TextImport::XmlElement::latin1(int tag, bool optional) const
+{
+    const QByteArrayView value = raw(tag, optional);
+    return value.contains('&') ? text(tag).toLatin1() : value.toByteArray();
 }
 
 } // namespace BrickLink
@@ -3,8 +3,12 @@
 
 #pragma once
 
+#include <array>
+
 #include <QtCore/QString>
 #include <QtCore/QByteArray>
+#include <QtCore/QByteArrayView>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QHash>
 #include <QtCore/QVector>
 #include <QCoro/QCoroTask>
@@ -32,22 +36,37 @@ public:
     QCoro::Task<> importInventories();
     void finalize();
     void exportDatabase();
+    void printTimings();
 
     void setApiQuirks(const QSet<ApiQuirk> &apiQuirks);
     void setApiKeys(const QHash<QByteArray, QString> &apiKeys);
 
 private:
+    // the transfer only runs a few jobs in parallel anyway: this just keeps its queue filled
+    static constexpr int MaxConcurrentInventoryDownloads = 16;
+
+    struct ParsedInventory {
+        const Item *item = nullptr;
+        QVector<Item::ConsistsOf> inventory;
+        QVector<QPair<uint, uint>> knownColors; // item-idx, color-idx
+        QString error;
+    };
+
     QCoro::Task<QByteArray> download(const QUrl &url, const QString &fileName);
 
     void readColors(const QByteArray &xml);
     void readCategories(const QByteArray &xml);
     void readItemTypes(const QByteArray &xml);
-    void readItems(const QByteArray &xml, const ItemType *itt);
+    void readItems(const QVector<QByteArray> &xmls);
+    std::vector<Item> parseItems(const QByteArray &xml, const ItemType *itt) const;
     void readAdditionalItemCategories(const QByteArray &csv, const ItemType *itt);
     void readPartColorCodes(const QByteArray &xml);
     const Item *readInventory(char itemTypeId, const QByteArray &itemId,
                               const QDateTime &lastModified, const QByteArray &xml,
                               bool failSilently = false);
+    ParsedInventory parseInventory(char itemTypeId, const QByteArray &itemId,
+                                   const QDateTime &lastModified, const QByteArray &xml) const;
+    void addInventory(const ParsedInventory &parsed);
     void readLDrawColors(const QByteArray &ldconfig, const QByteArray &rebrickableColors);
     void readInventoryList(const QByteArray &csv);
     void readChangeLog(const QByteArray &csv);
@@ -67,10 +86,29 @@ private:
     void message(const QString &text);
     void message(int level, const QString &text);
 
-    static void xmlParse(const QByteArray &xml, QStringView rootName, QStringView elementName,
-                         const std::function<void(const QHash<QString, QString> &)> &callback);
-    static QString xmlTagText(const QHash<QString, QString> &element, QStringView tagName,
-                              bool optional = false);
+    // One <elementName> record: the child tags are addressed by their index in the tagNames list
+    // given to xmlParse(). The views point directly into the XML document.
+    class XmlElement
+    {
+    public:
+        QByteArrayView raw(int tag, bool optional = false) const; // trimmed, entities not decoded
+        QString text(int tag, bool optional = false) const;
+        QByteArray latin1(int tag, bool optional = false) const;
+
+    private:
+        static constexpr int MaxTags = 32;
+
+        std::array<QByteArrayView, MaxTags> m_values;
+        quint32 m_present = 0;
+        const QByteArrayView *m_tagNames = nullptr;
+        bool m_doubleEscaped = false;
+
+        friend class TextImport;
+    };
+
+    static void xmlParse(const QByteArray &xml, QByteArrayView rootName, QByteArrayView elementName,
+                         std::initializer_list<QByteArrayView> tagNames,
+                         const std::function<void(const XmlElement &)> &callback);
 private:
     QString m_archiveName;
     std::unique_ptr<MiniZip> m_downloadArchive;
@@ -87,6 +125,8 @@ private:
     QString m_rebrickableApiKey;
     bool m_skipDownload = false;
     int m_currentStep = 0;
+    QElapsedTimer m_stepTimer;
+    QVector<QPair<QString, qint64>> m_stepTimings; // step -> msec
 };
 
 } // namespace BrickLink
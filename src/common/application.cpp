@@ -969,6 +969,12 @@ bool Application::initBrickLink()
     BrickLink::core()->setUpdateIntervals(Config::inst()->updateIntervals());
     connect(Config::inst(), &Config::updateIntervalsChanged,
             BrickLink::core(), &BrickLink::Core::setUpdateIntervals);
+    BrickLink::core()->setCacheSizeLimits(Config::inst()->cacheSizeLimits());
+    connect(Config::inst(), &Config::cacheSizeLimitsChanged,
+            BrickLink::core(), &BrickLink::Core::setCacheSizeLimits);
+    BrickLink::core()->setPriceGuideConcurrentBatches(Config::inst()->priceGuideConcurrentBatches());
+    connect(Config::inst(), &Config::priceGuideConcurrentBatchesChanged,
+            BrickLink::core(), &BrickLink::Core::setPriceGuideConcurrentBatches);
 
     QString lastRetrieverId = Config::inst()->value(u"BrickLink/VAT/LastRetrieverId"_qs).toString();
     QString retrieverId = BrickLink::core()->priceGuideCache()->retrieverId();
@@ -360,6 +360,65 @@ void Config::setUpdateIntervals(const QMap<QByteArray, int> &uiv)
         emit updateIntervalsChanged(updateIntervals());
 }
 
+QMap<QByteArray, int> Config::cacheSizeLimits() const
+{
+    QMap<QByteArray, int> csl = cacheSizeLimitsDefault();
+
+    static const std::array lut = { "Picture", "PriceGuide" };
+
+    for (const auto &cs : lut)
+        csl[cs] = value(u"BrickLink/CacheSizeLimit/"_qs + QString::fromLatin1(cs), csl[cs]).toInt();
+    return csl;
+}
+
+QMap<QByteArray, int> Config::cacheSizeLimitsDefault() const
+{
+    QMap<QByteArray, int> csl;
+
+#if defined(Q_OS_ANDROID) || defined(Q_OS_IOS)
+    csl.insert("Picture",    1000);
+#else
+    csl.insert("Picture",    4000);
+#endif
+    csl.insert("PriceGuide",  250);
+
+    return csl;
+}
+
+void Config::setCacheSizeLimits(const QMap<QByteArray, int> &csl)
+{
+    bool modified = false;
+    QMap<QByteArray, int> old_csl = cacheSizeLimits();
+
+    for (QMapIterator<QByteArray, int> it(csl); it.hasNext(); ) {
+        it.next();
+
+        if (it.value() != old_csl.value(it.key())) {
+            setValue(u"BrickLink/CacheSizeLimit/"_qs + QString::fromLatin1(it.key()), it.value());
+            modified = true;
+        }
+    }
+
+    if (modified)
+        emit cacheSizeLimitsChanged(cacheSizeLimits());
+}
+
+int Config::priceGuideConcurrentBatches() const
+{
+    // the transfer only runs 6 jobs in parallel: leave some for everything else
+    return std::clamp(value(u"BrickLink/PriceGuideConcurrentBatches"_qs, 3).toInt(), 1, 6);
+}
+
+void Config::setPriceGuideConcurrentBatches(int count)
+{
+    count = std::clamp(count, 1, 6);
+
+    if (priceGuideConcurrentBatches() != count) {
+        setValue(u"BrickLink/PriceGuideConcurrentBatches"_qs, count);
+        emit priceGuideConcurrentBatchesChanged(count);
+    }
+}
+
 QByteArray Config::columnLayout(const QString &id) const
 {
     if (id.isEmpty())
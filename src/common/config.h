@@ -107,6 +107,11 @@ public:
     QMap<QByteArray, int> updateIntervals() const;
     QMap<QByteArray, int> updateIntervalsDefault() const;
     void setUpdateIntervals(const QMap<QByteArray, int> &intervals);
+    QMap<QByteArray, int> cacheSizeLimits() const; // in MB, 0 means unlimited
+    QMap<QByteArray, int> cacheSizeLimitsDefault() const;
+    void setCacheSizeLimits(const QMap<QByteArray, int> &limits);
+    int priceGuideConcurrentBatches() const;
+    void setPriceGuideConcurrentBatches(int count);
 
     enum class UISize {
         System,
@@ -184,6 +189,8 @@ signals:
     void showDifferenceIndicatorsChanged(bool b);
     void visualChangesMarkModifiedChanged(bool b);
     void updateIntervalsChanged(const QMap<QByteArray, int> &intervals);
+    void cacheSizeLimitsChanged(const QMap<QByteArray, int> &limits);
+    void priceGuideConcurrentBatchesChanged(int count);
     void onlineStatusChanged(bool b);
     void toolBarSizeChanged(Config::UISize iconSize);
     void iconSizePercentChanged(int p);
@@ -1024,8 +1024,16 @@ void Document::setPriceToGuide(BrickLink::Time time, BrickLink::Price price, boo
     m_setToPG->currencyRate = Currency::inst()->rate(m_model->currencyCode());
     m_setToPG->noPgOption = noPgOption;
 
-    for (Lot *lot : sel) {
-        BrickLink::PriceGuide *pg = BrickLink::core()->priceGuideCache()->priceGuide(lot->item(), lot->color());
+    // resolve all price guides in one go: the cache loads the missing ones in batches
+    QVector<std::pair<const BrickLink::Item *, const BrickLink::Color *>> itemsAndColors;
+    itemsAndColors.reserve(sel.size());
+    for (const Lot *lot : sel)
+        itemsAndColors.emplace_back(lot->item(), lot->color());
+    const auto pgs = BrickLink::core()->priceGuideCache()->priceGuides(itemsAndColors);
+
+    for (qsizetype i = 0; i < sel.size(); ++i) {
+        Lot *lot = sel.at(i);
+        BrickLink::PriceGuide *pg = pgs.at(i); // already referenced
 
         if (pg && forceUpdate && (pg->updateStatus() != BrickLink::UpdateStatus::Updating)) {
             pg->update();
@@ -1034,15 +1042,16 @@ void Document::setPriceToGuide(BrickLink::Time time, BrickLink::Price price, boo
         if (pg && ((pg->updateStatus() == BrickLink::UpdateStatus::Loading)
                    || (pg->updateStatus() == BrickLink::UpdateStatus::Updating))) {
             m_setToPG->priceGuides.insert(pg, lot);
-            pg->addRef();
 
         } else {
             if (!updatePriceToGuide(lot, pg))
                 ++m_setToPG->failCount;
             ++m_setToPG->doneCount;
-            emit blockingOperationProgress(m_setToPG->doneCount, m_setToPG->totalCount);
+            if (pg)
+                pg->release();
         }
     }
+    emit blockingOperationProgress(m_setToPG->doneCount, m_setToPG->totalCount);
 
     setBlockingOperationTitle(tr("Downloading price guide data from BrickLink"));
     setBlockingOperationCancelCallback([this]() { cancelPriceGuideUpdates(); });
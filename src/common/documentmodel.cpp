@@ -3,15 +3,20 @@
 
 #include <utility>
 #include <algorithm>
+#include <numeric>
 
 #include <QCoreApplication>
+#include <QCollator>
 #include <QCursor>
 #include <QFileInfo>
 #include <QDir>
 #include <QTimer>
 #include <QtConcurrentFilter>
+#include <QtConcurrentMap>
+#include <QLoggingCategory>
 #include <QtAlgorithms>
 #include <QStringListModel>
+#include <QStringMatcher>
 
 #if defined(MODELTEST)
 #  include <QAbstractItemModelTester>
@@ -22,6 +27,7 @@
 
 #include "utility/utility.h"
 #include "common/currency.h"
+#include "common/uihelpers.h"
 #include "common/undo.h"
 #include "utility/qparallelsort.h"
 #include "bricklink/core.h"
@@ -33,6 +39,11 @@
 
 using namespace std::chrono_literals;
 
+Q_LOGGING_CATEGORY(LogModel, "model", QtWarningMsg)
+
+// below this, the thread pool overhead is larger than the work being distributed
+static constexpr qsizetype MinParallelLots = 1000;
+
 
 template <auto G, auto S>
 struct FieldOp
@@ -149,6 +160,9 @@ enum {
     // values starting at 0x00010000 are reserved for the view
 };
 
+// undo data of ChangeCmds beyond this size is moved out of memory
+static constexpr qsizetype MaxUndoMemory = 64 * 1024 * 1024;
+
 
 AddRemoveCmd::AddRemoveCmd(Type t, DocumentModel *model, const QVector<int> &positions,
                            const QVector<int> &sortedPositions,
@@ -225,12 +239,25 @@ ChangeCmd::ChangeCmd(DocumentModel *model, const std::vector<std::pair<Lot *, Lo
     : QUndoCommand()
     , m_model(model)
     , m_hint(hint)
-    , m_changes(changes)
 {
-    std::sort(m_changes.begin(), m_changes.end(), [](const auto &a, const auto &b) {
-        return a.first < b.first;
+    std::vector<qsizetype> order(changes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&changes](qsizetype a, qsizetype b) {
+        return changes[size_t(a)].first < changes[size_t(b)].first;
     });
 
+    // only the fields that differ are recorded, instead of full copies of the lots
+    m_lots.reserve(qsizetype(changes.size()));
+    m_fields.reserve(qsizetype(changes.size()));
+    QDataStream ds(&m_values, QIODevice::WriteOnly);
+    for (qsizetype i : order) {
+        const auto &[lot, value] = changes[size_t(i)];
+        const auto fields = lot->differingFields(value);
+        m_lots.append(lot);
+        m_fields.append(fields);
+        value.saveFields(ds, fields);
+    }
+
     if (!s_eventLoopCounter) {
         s_eventLoopCounter = new QTimer(QCoreApplication::instance());
         s_eventLoopCounter->setProperty("loopCount", uint(0));
@@ -252,7 +279,7 @@ void ChangeCmd::updateText()
 {
     //: Generic undo/redo text for table edits: %1 == column name (e.g. "Price")
     setText(QCoreApplication::translate("ChangeCmd", "Modified %1 on %Ln item(s)", nullptr,
-                                        int(m_changes.size()))
+                                        int(m_lots.size()))
             //: Generic undo/redo text for table edits: if more than one column was edited at once
             .arg((m_hint < DocumentModel::FieldCount) ? m_model->headerData(m_hint, Qt::Horizontal).toString()
                                                  : QCoreApplication::translate("ChangeCmd", "multiple fields")));
@@ -268,14 +295,50 @@ bool ChangeCmd::mergeWith(const QUndoCommand *other)
     if (other->id() == id()) {
         auto *otherChange = static_cast<const ChangeCmd *>(other);
         if ((m_loopCount == otherChange->m_loopCount) && (m_hint == otherChange->m_hint)) {
-            std::copy_if(otherChange->m_changes.cbegin(), otherChange->m_changes.cend(),
-                         std::back_inserter(m_changes), [this](const auto &change) {
-                return !std::binary_search(m_changes.begin(), m_changes.end(),
-                                           std::make_pair(change.first, Lot { }),
-                                           [](const auto &a, const auto &b) {
-                    return a.first < b.first;
-                });
-            });
+            // merge the two sorted lists: for lots in both, we need the state from before
+            // this command, plus the fields that were only changed by the other one
+            QByteArray thisValues;
+            QByteArray otherValues;
+            if (!loadValues(thisValues) || !otherChange->loadValues(otherValues))
+                return false;
+            QDataStream thisIn(thisValues);
+            QDataStream otherIn(otherValues);
+
+            LotList lots;
+            QVector<Lot::DeltaFields> fields;
+            QByteArray mergedValues;
+            QDataStream out(&mergedValues, QIODevice::WriteOnly);
+            Lot scratch;
+
+            const auto &otherLots = otherChange->m_lots;
+            qsizetype i = 0, j = 0;
+
+            while ((i < m_lots.size()) || (j < otherLots.size())) {
+                Lot *lot;
+                Lot::DeltaFields f = 0;
+
+                if ((j == otherLots.size()) || ((i < m_lots.size()) && (m_lots.at(i) < otherLots.at(j)))) {
+                    lot = m_lots.at(i);
+                    f = m_fields.at(i++);
+                    scratch.loadFields(thisIn, f);
+                } else if ((i == m_lots.size()) || (otherLots.at(j) < m_lots.at(i))) {
+                    lot = otherLots.at(j);
+                    f = otherChange->m_fields.at(j++);
+                    scratch.loadFields(otherIn, f);
+                } else {
+                    lot = m_lots.at(i);
+                    scratch.loadFields(otherIn, otherChange->m_fields.at(j));
+                    scratch.loadFields(thisIn, m_fields.at(i));
+                    f = m_fields.at(i++) | otherChange->m_fields.at(j++);
+                }
+                scratch.saveFields(out, f);
+                lots.append(lot);
+                fields.append(f);
+            }
+            m_lots = lots;
+            m_fields = fields;
+            m_values = mergedValues;
+            m_spillFile.reset();
             updateText();
             return true;
         }
@@ -285,7 +348,17 @@ bool ChangeCmd::mergeWith(const QUndoCommand *other)
 
 void ChangeCmd::redo()
 {
-    m_model->changeLotsDirect(m_changes);
+    QByteArray values;
+    if (!loadValues(values)) {
+        // applying default values would silently corrupt the lots, and the other commands on
+        // the stack do not match the lots anymore if just this one is skipped
+        qCWarning(LogModel) << "Could not read the undo data back from" << m_spillFile->fileName();
+        m_model->discardUndoHistory();
+        return;
+    }
+    m_values = values;
+    m_spillFile.reset();
+    m_model->changeLotsDirect(m_lots, m_fields, m_values);
 }
 
 void ChangeCmd::undo()
@@ -293,6 +366,56 @@ void ChangeCmd::undo()
     redo();
 }
 
+qsizetype ChangeCmd::memoryUsage() const
+{
+    return m_lots.capacity() * qsizetype(sizeof(Lot *))
+            + m_fields.capacity() * qsizetype(sizeof(Lot::DeltaFields))
+            + m_values.capacity();
+}
+
+void ChangeCmd::spill()
+{
+    if (m_spillFile || m_values.isEmpty())
+        return;
+
+    // if the data cannot be written, it just stays in memory
+    auto file = std::make_unique<QTemporaryFile>();
+    if (!file->open() || (file->write(m_values) != m_values.size()) || !file->flush()) {
+        qCWarning(LogModel) << "Could not move the undo data to" << file->fileName() << ":" << file->errorString();
+        return;
+    }
+    file->close();
+    m_spillFile = std::move(file);
+    m_spilledSize = m_values.size();
+    m_values = { };
+}
+
+bool ChangeCmd::loadValues(QByteArray &values) const
+{
+    if (!m_spillFile) {
+        values = m_values;
+        return true;
+    }
+
+    if (!m_spillFile->open())
+        return false;
+    QByteArray ba = m_spillFile->readAll();
+    m_spillFile->close();
+    if (ba.size() != m_spilledSize)
+        return false;
+
+    // make sure the data decodes completely before it gets near the real lots
+    QDataStream ds(ba);
+    Lot scratch;
+    for (const auto fields : m_fields)
+        scratch.loadFields(ds, fields);
+    if ((ds.status() != QDataStream::Ok) || !ds.atEnd())
+        return false;
+
+    values = ba;
+    return true;
+}
+
 
 ///////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////
@@ -457,41 +580,53 @@ DocumentStatistics::DocumentStatistics(const DocumentModel *model, const LotList
     m_incomplete = 0;
     bool weight_missing = false;
 
-    for (const Lot *lot : list) {
-        if (ignoreExcluded && (lot->status() == BrickLink::Status::Exclude))
-            continue;
+    quint64 errorsMask = model->m_lotFlagsMask.first;
+    if (ignorePriceAndQuantityErrors)
+        errorsMask &= ((1ULL << DocumentModel::PartNo) | (1ULL << DocumentModel::Color));
+    const quint64 differencesMask = model->m_lotFlagsMask.second;
 
+    auto add = [&](int qty, double price, double minPrice, double cost, double totalWeight,
+                   quint64 errors, quint64 differences, bool incomplete) {
         ++m_lots;
-
-        int qty = lot->quantity();
-        double price = lot->price();
-
         m_val += (qty * price);
-        m_cost += (qty * lot->cost());
-
-        for (int i = 0; i < 3; i++) {
-            if (lot->tierQuantity(i) && !qFuzzyIsNull(lot->tierPrice(i)))
-                price = lot->tierPrice(i);
-        }
-        m_minval += (qty * price * (1.0 - double(lot->sale()) / 100.0));
+        m_cost += (qty * cost);
+        m_minval += (qty * minPrice);
         m_items += qty;
 
-        if (lot->totalWeight() > 0)
-            m_weight += lot->totalWeight();
+        if (totalWeight > 0)
+            m_weight += totalWeight;
         else
             weight_missing = true;
 
-        auto flags = model->lotFlags(lot);
-        if (flags.first) {
-            if (ignorePriceAndQuantityErrors)
-                flags.first &= ((1ULL << DocumentModel::PartNo) | (1ULL << DocumentModel::Color));
-            m_errors += qPopulationCount(flags.first);
+        m_errors += qPopulationCount(errors & errorsMask);
+        m_differences += qPopulationCount(differences & differencesMask);
+        if (incomplete)
+            m_incomplete++;
+    };
+
+    const auto &lc = model->m_lotColumns;
+    auto addRow = [&](size_t row) {
+        if (!ignoreExcluded || !lc.excluded[row]) {
+            add(lc.quantity[row], lc.price[row], lc.minPrice[row], lc.cost[row], lc.totalWeight[row],
+                lc.errors[row], lc.differences[row], lc.incomplete[row]);
         }
-        if (flags.second)
-            m_differences += qPopulationCount(flags.second);
+    };
 
-        if (lot->isIncomplete())
-            m_incomplete++;
+    if ((list.constData() == model->m_lots.constData()) && (lc.quantity.size() == size_t(list.size()))) {
+        for (size_t row = 0; row < lc.quantity.size(); ++row)
+            addRow(row);
+    } else {
+        for (const Lot *lot : list) {
+            const int row = model->m_lotIndex.value(lot, -1);
+            if ((row >= 0) && (size_t(row) < lc.quantity.size())) {
+                addRow(size_t(row));
+            } else if (!ignoreExcluded || (lot->status() != BrickLink::Status::Exclude)) {
+                // not part of this document
+                const auto flags = model->m_lotFlags.value(lot, { });
+                add(lot->quantity(), lot->price(), DocumentModel::LotColumns::minPrice(lot), lot->cost(),
+                    lot->totalWeight(), flags.first, flags.second, lot->isIncomplete());
+            }
+        }
     }
     if (weight_missing)
         m_weight = qFuzzyIsNull(m_weight) ? -std::numeric_limits<double>::min() : -m_weight;
@@ -706,19 +841,23 @@ QCoro::Task<int> DocumentModel::addLots(BrickLink::LotList &&lotsRef, AddLotMode
     QHash<BrickLink::Lot *, qsizetype> mergedLots;
     int mergedCount = 0;
 
+    // the merge candidate for every key is the last matching lot in sort order
+    QHash<MergeKey, Lot *> mergeCandidates;
+    if (addLotMode != AddLotMode::AddAsNew) {
+        mergeCandidates.reserve(m_sortedLots.size());
+        for (Lot *otherLot : std::as_const(m_sortedLots)) {
+            if (auto key = mergeKey(otherLot))
+                mergeCandidates.insert(*key, otherLot);
+        }
+    }
+
     for (int i = 0; i < lots.size(); ++i) {
         Lot *lot = lots.at(i);
 
         if (addLotMode != AddLotMode::AddAsNew) {
             Lot *mergeLot = nullptr;
-
-            for (int j = int(m_sortedLots.count()) - 1; j >= 0; --j) {
-                Lot *otherLot = m_sortedLots.at(j);
-                if (canLotsBeMerged(*lot, *otherLot)) {
-                    mergeLot = otherLot;
-                    break;
-                }
-            }
+            if (auto key = mergeKey(lot))
+                mergeLot = mergeCandidates.value(*key);
             if (!mergeLot) {  // record "lot" to be added
                 Consolidate c({ nullptr, lot });
                 quietConsolidateList.append(c);  // record "lot" to be added
@@ -853,22 +992,29 @@ QCoro::Task<> DocumentModel::consolidateLots(BrickLink::LotList lots)
         co_return;
 
     QVector<Consolidate> consolidateList;
-    LotList sourceLots = lots;
 
-    for (int i = 0; i < sourceLots.count(); ++i) {
-        Lot *lot = sourceLots.at(i);
-        LotList mergeLots;
+    // group the mergeable lots, in the order of their first appearance
+    QHash<MergeKey, qsizetype> groupIndex;
+    QVector<LotList> groups;
+    QSet<const Lot *> seenLots;
 
-        for (int j = i + 1; j < sourceLots.count(); ++j) {
-            Lot *otherLot = sourceLots.at(j);
-            if (canLotsBeMerged(*lot, *otherLot))
-                mergeLots << sourceLots.takeAt(j--);  // clazy:exclude=reserve-candidates
-        }
-        if (mergeLots.isEmpty())
+    for (Lot *lot : std::as_const(lots)) {
+        auto key = mergeKey(lot);
+        if (!key || seenLots.contains(lot))
             continue;
+        seenLots.insert(lot);
 
-        mergeLots.prepend(sourceLots.at(i));
-        consolidateList.emplace_back(mergeLots);
+        auto it = groupIndex.constFind(*key);
+        if (it == groupIndex.cend()) {
+            groupIndex.insert(*key, groups.size());
+            groups.append({ lot });
+        } else {
+            groups[*it].append(lot);
+        }
+    }
+    for (const LotList &group : std::as_const(groups)) {
+        if (group.size() > 1)
+            consolidateList.emplace_back(group);
     }
 
     if (consolidateList.isEmpty())
@@ -973,6 +1119,14 @@ bool DocumentModel::canLotsBeMerged(const Lot &lot1, const Lot &lot2)
                 (lot2.status() == BrickLink::Status::Exclude)));
 }
 
+std::optional<DocumentModel::MergeKey> DocumentModel::mergeKey(const Lot *lot)
+{
+    if (lot->isIncomplete())
+        return std::nullopt;
+    return MergeKey { lot->item(), lot->color(), lot->condition(), lot->subCondition(),
+                      (lot->status() == BrickLink::Status::Exclude) };
+}
+
 bool DocumentModel::mergeLotFields(const Lot &from, Lot &to, const FieldMergeModes &fieldMergeModes)
 {
     if (!canLotsBeMerged(from, to))
@@ -1181,12 +1335,50 @@ void DocumentModel::removeLots(const LotList &lots)
 void DocumentModel::changeLot(Lot *lot, const Lot &value, DocumentModel::Field hint)
 {
     m_undo->push(new ChangeCmd(this, {{ lot, value }}, hint));
+    limitUndoMemory();
 }
 
 void DocumentModel::changeLots(const std::vector<std::pair<Lot *, Lot>> &changes, Field hint)
 {
-    if (!changes.empty())
+    if (!changes.empty()) {
         m_undo->push(new ChangeCmd(this, changes, hint));
+        limitUndoMemory();
+    }
+}
+
+void DocumentModel::limitUndoMemory()
+{
+    // the most recent changes stay in memory, older ones are moved to temporary files
+    qsizetype used = 0;
+
+    std::function<void(const QUndoCommand *)> check = [&](const QUndoCommand *cmd) {
+        for (int i = cmd->childCount() - 1; i >= 0; --i)
+            check(cmd->child(i));
+        if (cmd->id() == CID_Change) {
+            auto *changeCmd = static_cast<ChangeCmd *>(const_cast<QUndoCommand *>(cmd));
+            if (used > MaxUndoMemory)
+                changeCmd->spill();
+            used += changeCmd->memoryUsage();
+        }
+    };
+    for (int i = m_undo->count() - 1; i >= 0; --i)
+        check(m_undo->command(i));
+}
+
+void DocumentModel::discardUndoHistory()
+{
+    if (m_discardingUndoHistory)
+        return;
+    m_discardingUndoHistory = true;
+
+    // we are called from within a command's redo()/undo(), so the stack can't be cleared yet
+    QMetaObject::invokeMethod(this, [this]() {
+        m_undo->clear();
+        m_discardingUndoHistory = false;
+        // the lots are not in the saved state anymore
+        m_undo->resetClean();
+        UIHelpers::warning(tr("The undo history of this document could not be read back from disk and had to be discarded."));
+    }, Qt::QueuedConnection);
 }
 
 void DocumentModel::setLotsDirect(const LotList &lots)
@@ -1227,6 +1419,7 @@ void DocumentModel::insertLotsDirect(const LotList &lots, QVector<int> &position
             m_sortedLots.append(lot);
             m_filteredLots.append(lot);
         }
+        trackChangedLot(lot);
 
         // this is really a new lot, not just a redo - start with no differences
         if (!m_differenceBase.contains(lot))
@@ -1235,9 +1428,9 @@ void DocumentModel::insertLotsDirect(const LotList &lots, QVector<int> &position
 
     rebuildLotIndex();
     rebuildFilteredLotIndex();
+    rebuildLotColumns();
 
-    for (Lot *lot : std::as_const(lots))
-        updateLotFlags(lot);
+    updateLotFlags(lots);
 
     QModelIndexList after;
     after.reserve(before.size());
@@ -1281,10 +1474,12 @@ void DocumentModel::removeLotsDirect(const LotList &lots, QVector<int> &position
         m_sortedLots.removeAt(sortIdx);
         if (filterIdx >= 0)
             m_filteredLots.removeAt(filterIdx);
+        trackChangedLot(lot, true);
     }
 
     rebuildLotIndex();
     rebuildFilteredLotIndex();
+    rebuildLotColumns();
 
     QModelIndexList after;
     after.reserve(before.size());
@@ -1303,19 +1498,39 @@ void DocumentModel::removeLotsDirect(const LotList &lots, QVector<int> &position
         emit isFilteredChanged(m_isFiltered = false);
 }
 
-void DocumentModel::changeLotsDirect(std::vector<std::pair<Lot *, Lot>> &changes)
+void DocumentModel::changeLotsDirect(const LotList &lots, const QVector<Lot::DeltaFields> &fields,
+                                     QByteArray &values)
 {
-    Q_ASSERT(!changes.empty());
+    Q_ASSERT(!lots.empty());
+    Q_ASSERT(lots.size() == fields.size());
 
-    for (auto &change : changes) {
-        Lot *lot = change.first;
-        std::swap(*lot, change.second);
+    // swap the recorded field values with the current ones
+    QByteArray oldValues;
+    QDataStream out(&oldValues, QIODevice::WriteOnly);
+    QDataStream in(values);
 
-        QModelIndex idx1 = index(lot, 0);
-        QModelIndex idx2 = idx1.siblingAtColumn(columnCount() - 1);
-        updateLotFlags(lot);
-        emitDataChanged(idx1, idx2);
+    int firstRow = std::numeric_limits<int>::max();
+    int lastRow = -1;
+
+    for (qsizetype i = 0; i < lots.size(); ++i) {
+        Lot *lot = lots.at(i);
+        lot->saveFields(out, fields.at(i));
+        lot->loadFields(in, fields.at(i));
+        Q_ASSERT(in.status() == QDataStream::Ok);
+        trackChangedLot(lot);
+        updateLotColumns(lot);
+
+        const int row = m_filteredLotIndex.value(lot, -1);
+        if (row >= 0) {
+            firstRow = std::min(firstRow, row);
+            lastRow = std::max(lastRow, row);
+        }
     }
+    values = oldValues;
+
+    updateLotFlags(lots);
+    if (lastRow >= 0)
+        emitDataChanged(index(firstRow, 0), index(lastRow, columnCount() - 1));
 
     emitStatisticsChanged();
 
@@ -1362,9 +1577,11 @@ void DocumentModel::changeCurrencyDirect(const QString &ccode, double crate, dou
             delete [] prices;
             prices = nullptr;
         }
+        rebuildLotColumns();
 
         emitDataChanged();
         emitStatisticsChanged();
+        resetChangedLotTracking();
 
         //TODO: we should remember and re-apply the isSorted/isFiltered state
         if (isSorted())
@@ -1431,7 +1648,44 @@ void DocumentModel::emitStatisticsChanged()
     m_delayedEmitOfStatisticsChanged->start();
 }
 
-void DocumentModel::updateLotFlags(const Lot *lot)
+// the columns that can differ from the difference mode base: the same as comparing
+// dataForEditRole() of each column, but without going through QVariants
+static quint64 differenceFlags(const Lot *lot, const Lot *base)
+{
+    quint64 updated = 0;
+    auto check = [&updated](DocumentModel::Field f, bool differs) {
+        if (differs)
+            updated |= (1ULL << f);
+    };
+    auto alternateIds = [](const Lot *l) {
+        return l->item() ? l->item()->alternateIds() : QByteArray { };
+    };
+
+    check(DocumentModel::PartNo,       lot->itemId() != base->itemId());
+    check(DocumentModel::Condition,    lot->condition() != base->condition());
+    check(DocumentModel::Color,        lot->color() != base->color());
+    check(DocumentModel::Quantity,     lot->quantity() != base->quantity());
+    check(DocumentModel::Price,        lot->price() != base->price());
+    check(DocumentModel::Cost,         lot->cost() != base->cost());
+    check(DocumentModel::Bulk,         lot->bulkQuantity() != base->bulkQuantity());
+    check(DocumentModel::Sale,         lot->sale() != base->sale());
+    check(DocumentModel::Comments,     lot->comments() != base->comments());
+    check(DocumentModel::Remarks,      lot->remarks() != base->remarks());
+    check(DocumentModel::TierQ1,       lot->tierQuantity(0) != base->tierQuantity(0));
+    check(DocumentModel::TierP1,       lot->tierPrice(0) != base->tierPrice(0));
+    check(DocumentModel::TierQ2,       lot->tierQuantity(1) != base->tierQuantity(1));
+    check(DocumentModel::TierP2,       lot->tierPrice(1) != base->tierPrice(1));
+    check(DocumentModel::TierQ3,       lot->tierQuantity(2) != base->tierQuantity(2));
+    check(DocumentModel::TierP3,       lot->tierPrice(2) != base->tierPrice(2));
+    check(DocumentModel::Retain,       lot->retain() != base->retain());
+    check(DocumentModel::Stockroom,    lot->stockroom() != base->stockroom());
+    check(DocumentModel::Reserved,     lot->reserved() != base->reserved());
+    check(DocumentModel::AlternateIds, (lot->item() != base->item())
+                                       && (alternateIds(lot) != alternateIds(base)));
+    return updated;
+}
+
+QPair<quint64, quint64> DocumentModel::calculateLotFlags(const Lot *lot) const
 {
     quint64 errors = 0;
     quint64 updated = 0;
@@ -1457,39 +1711,34 @@ void DocumentModel::updateLotFlags(const Lot *lot)
     if (lot->status() == BrickLink::Status::Exclude)
         errors = 0;
 
-    if (auto base = differenceBaseLot(lot)) {
-        static const quint64 ignoreMask = 0ULL
-                | (1ULL << Index)
-                | (1ULL << Status)
-                | (1ULL << Picture)
-                | (1ULL << Description)
-                | (1ULL << QuantityOrig)
-                | (1ULL << QuantityDiff)
-                | (1ULL << PriceOrig)
-                | (1ULL << PriceDiff)
-                | (1ULL << Total)
-                | (1ULL << Category)
-                | (1ULL << ItemType)
-                | (1ULL << LotId)
-                | (1ULL << Weight)
-                | (1ULL << TotalWeight)
-                | (1ULL << YearReleased)
-                | (1ULL << Marker)
-                | (1ULL << DateAdded)
-                | (1ULL << DateLastSold);
-
-        for (Field f = Index; f != FieldCount; f = Field(f + 1)) {
-            quint64 fmask = (1ULL << f);
-            if (fmask & ignoreMask)
-                continue;
-            if (dataForEditRole(lot, f) != dataForEditRole(base, f))
-                updated |= fmask;
-        }
-    }
+    if (auto base = differenceBaseLot(lot))
+        updated = differenceFlags(lot, base);
+
+    return { errors, updated };
+}
 
+void DocumentModel::updateLotFlags(const Lot *lot)
+{
+    const auto [errors, updated] = calculateLotFlags(lot);
     setLotFlags(lot, errors, updated);
 }
 
+void DocumentModel::updateLotFlags(const LotList &lots)
+{
+    // the calculation is read-only, so it can be spread out over the thread pool
+    std::vector<QPair<quint64, quint64>> flags(size_t(lots.size()));
+    auto calculate = [&](QPair<quint64, quint64> &f) {
+        f = calculateLotFlags(lots.at(&f - flags.data()));
+    };
+    if (lots.size() >= MinParallelLots)
+        QtConcurrent::blockingMap(flags, calculate);
+    else
+        std::for_each(flags.begin(), flags.end(), calculate);
+
+    for (qsizetype i = 0; i < lots.size(); ++i)
+        setLotFlags(lots.at(i), flags[size_t(i)].first, flags[size_t(i)].second);
+}
+
 void DocumentModel::resetDifferenceMode(const LotList &lotList)
 {
     m_undo->push(new ResetDifferenceModeCmd(this, lotList.isEmpty() ? lots() : lotList));
@@ -1498,9 +1747,9 @@ void DocumentModel::resetDifferenceMode(const LotList &lotList)
 void DocumentModel::resetDifferenceModeDirect(QHash<const Lot *, Lot> &differenceBase)
 {
     std::swap(m_differenceBase, differenceBase);
+    resetChangedLotTracking();
 
-    for (const auto *lot : std::as_const(m_lots))
-        updateLotFlags(lot);
+    updateLotFlags(m_lots);
 
     emitDataChanged();
 }
@@ -1557,15 +1806,33 @@ void DocumentModel::applyTo(const LotList &lots, const std::function<DocumentMod
     if (!at.isEmpty())
         beginMacro();
 
+    QElapsedTimer timer;
+    timer.start();
+
     int count = int(lots.size());
-    std::vector<std::pair<Lot *, Lot>> changes;
-    changes.reserve(uint(count));
+    std::vector<std::pair<Lot *, Lot>> changes(size_t(lots.size()));
+    std::vector<ApplyToResult> results(size_t(lots.size()), LotDidNotChange);
+
+    for (qsizetype i = 0; i < lots.size(); ++i)
+        changes[size_t(i)].first = lots.at(i);
+
+    auto apply = [&](std::pair<Lot *, Lot> &change) {
+        change.second = *change.first;
+        results[size_t(&change - changes.data())] = callback(*change.first, change.second);
+    };
+    if (lots.size() >= MinParallelLots)
+        QtConcurrent::blockingMap(changes, apply);
+    else
+        std::for_each(changes.begin(), changes.end(), apply);
 
-    for (Lot *from : lots) {
-        Lot to = *from;
-        switch (callback(*from, to)) {
+    // compact the list down to the changed lots, keeping the selection order
+    size_t changed = 0;
+    for (size_t i = 0; i < changes.size(); ++i) {
+        switch (results[i]) {
         case LotChanged:
-            changes.emplace_back(from, to);
+            if (i != changed)
+                changes[changed] = changes[i];
+            ++changed;
             break;
         case LotDidNotChange:
             --count;
@@ -1574,8 +1841,11 @@ void DocumentModel::applyTo(const LotList &lots, const std::function<DocumentMod
             break;
         }
     }
+    changes.erase(changes.begin() + qsizetype(changed), changes.end());
     changeLots(changes);
 
+    qCDebug(LogModel) << "Applied" << at << "to" << lots.size() << "lots in" << timer.elapsed() << "ms";
+
     if (!at.isEmpty()) {
         //: Generic undo/redo text: %1 == action name (e.g. "Set price")
         endMacro(tr("%1 on %Ln item(s)", nullptr, count).arg(at));
@@ -1599,6 +1869,60 @@ void DocumentModel::rebuildLotIndex()
         m_lotIndex[m_lots.at(i)] = i;
 }
 
+void DocumentModel::LotColumns::resize(size_t size)
+{
+    quantity.resize(size);
+    price.resize(size);
+    minPrice.resize(size);
+    cost.resize(size);
+    totalWeight.resize(size);
+    errors.resize(size);
+    differences.resize(size);
+    excluded.resize(size);
+    incomplete.resize(size);
+}
+
+void DocumentModel::LotColumns::set(size_t row, const Lot *lot)
+{
+    quantity[row] = lot->quantity();
+    price[row] = lot->price();
+    minPrice[row] = LotColumns::minPrice(lot);
+    cost[row] = lot->cost();
+    totalWeight[row] = lot->totalWeight();
+    excluded[row] = (lot->status() == BrickLink::Status::Exclude);
+    incomplete[row] = lot->isIncomplete();
+}
+
+double DocumentModel::LotColumns::minPrice(const Lot *lot)
+{
+    double price = lot->price();
+    for (int i = 0; i < 3; i++) {
+        if (lot->tierQuantity(i) && !qFuzzyIsNull(lot->tierPrice(i)))
+            price = lot->tierPrice(i);
+    }
+    return price * (1.0 - double(lot->sale()) / 100.0);
+}
+
+void DocumentModel::rebuildLotColumns()
+{
+    m_lotColumns.resize(size_t(m_lots.size()));
+    for (qsizetype i = 0; i < m_lots.size(); ++i) {
+        const Lot *lot = m_lots.at(i);
+        m_lotColumns.set(size_t(i), lot);
+
+        const auto flags = m_lotFlags.value(lot, { });
+        m_lotColumns.errors[size_t(i)] = flags.first;
+        m_lotColumns.differences[size_t(i)] = flags.second;
+    }
+}
+
+void DocumentModel::updateLotColumns(const Lot *lot)
+{
+    const int row = m_lotIndex.value(lot, -1);
+    if ((row >= 0) && (size_t(row) < m_lotColumns.quantity.size()))
+        m_lotColumns.set(size_t(row), lot);
+}
+
 void DocumentModel::rebuildFilteredLotIndex()
 {
     m_filteredLotIndex.clear();
@@ -1663,6 +1987,12 @@ void DocumentModel::setLotFlags(const Lot *lot, quint64 errors, quint64 updated)
         else
             m_lotFlags.remove(lot);
 
+        const int row = m_lotIndex.value(lot, -1);
+        if ((row >= 0) && (size_t(row) < m_lotColumns.errors.size())) {
+            m_lotColumns.errors[size_t(row)] = errors;
+            m_lotColumns.differences[size_t(row)] = updated;
+        }
+
         emit lotFlagsChanged(lot);
         emitStatisticsChanged();
     }
@@ -1824,7 +2154,12 @@ QVariant DocumentModel::headerData(int section, Qt::Orientation orientation, int
 
 QString DocumentModel::dataForDisplayRole(const Lot *lot, Field f, bool asToolTip) const
 {
-    const auto &c = m_columns.value(f);
+    auto it = m_columns.constFind(f);
+    return (it != m_columns.cend()) ? dataForDisplayRole(*it, lot, asToolTip) : QString { };
+}
+
+QString DocumentModel::dataForDisplayRole(const Column &c, const Lot *lot, bool asToolTip)
+{
     if (c.displayFn) {
         return c.displayFn(lot, asToolTip);
     } else {
@@ -2437,6 +2772,22 @@ void DocumentModel::sortDirect(const QVector<QPair<int, Qt::SortOrder>> &columns
 {
     bool emitSortColumnsChanged = (columns != m_sortColumns);
     bool wasSorted = isSorted();
+    bool realSort = (columns.size() != 1) || (columns.at(0).first != -1);
+
+    // if only a few lots changed since the last sort, we just need to move those
+    if (unsortedLots.isEmpty() && realSort && !emitSortColumnsChanged && m_changedSinceSort
+            && (m_changedSinceSort->size() <= (m_sortedLots.size() / 4))) {
+        unsortedLots = m_sortedLots;
+        sorted = m_isSorted;
+        m_isSorted = true;
+
+        sortChangedLotsDirect(*m_changedSinceSort);
+        m_changedSinceSort.emplace();
+
+        if (isSorted() != wasSorted)
+            emit isSortedChanged(isSorted());
+        return;
+    }
 
     emit layoutAboutToBeChanged({ }, VerticalSortHint);
     const QModelIndexList before = persistentIndexList();
@@ -2447,68 +2798,17 @@ void DocumentModel::sortDirect(const QVector<QPair<int, Qt::SortOrder>> &columns
         m_isSorted = sorted;
         m_sortedLots = unsortedLots;
         unsortedLots.clear();
+        m_changedSinceSort.reset();
 
     } else {
         unsortedLots = m_sortedLots;
         sorted = m_isSorted;
         m_isSorted = true;
         m_sortedLots = m_lots;
+        m_changedSinceSort.emplace();
 
-        if ((columns.size() != 1) || (columns.at(0).first != -1)) {
-            // make the sort deterministic
-            auto columnsPlusIndex = columns;
-            bool needIndex = true;
-            for (const auto &[columnIndex, sortOrder] : columns) {
-                if (columnIndex == 0) {
-                    needIndex = false;
-                    break;
-                }
-            }
-            if (needIndex) {
-                columnsPlusIndex.append(qMakePair(0, columns.isEmpty() ? Qt::AscendingOrder
-                                                                       : columns.constFirst().second));
-            }
-
-            qParallelSort(m_sortedLots.begin(), m_sortedLots.end(),
-                          [this, columnsPlusIndex](const auto *lot1, const auto *lot2) {
-                std::partial_ordering o = std::partial_ordering::equivalent;
-                for (const auto &[columnIndex, sortOrder] : columnsPlusIndex) {
-                    const auto &column = m_columns.value(columnIndex);
-
-                    if (column.compareFn) {
-                        o = column.compareFn(lot1, lot2);
-                    } else if (column.dataFn) {
-                        const auto v1 = column.dataFn(lot1);
-                        const auto v2 = column.dataFn(lot2);
-
-                        // Qt (as of 6.5.0) does not support operator<=> on QVariant yet
-                        switch (column.type) {
-                        case Column::Type::String:
-                            o = v1.toString().localeAwareCompare(v2.toString()) <=> 0; break;
-                        case Column::Type::Integer:
-                        case Column::Type::NonLocalizedInteger:
-                        case Column::Type::Enum:
-                            o = v1.toLongLong() <=> v2.toLongLong(); break;
-                        case Column::Type::Currency:
-                        case Column::Type::Weight:
-                            o = Utility::fuzzyCompare(v1.toDouble(), v2.toDouble()); break;
-                        case Column::Type::Date:
-                            o = v1.toDateTime().toSecsSinceEpoch() <=> v2.toDateTime().toSecsSinceEpoch(); break;
-                        case Column::Type::Special:
-                            o = std::partial_ordering::equivalent; break;
-                        default:
-                            o = std::partial_ordering::unordered; break;
-                        }
-                    }
-                    if (o != 0) {
-                        if (sortOrder == Qt::DescendingOrder)
-                            o = (o < 0) ? std::partial_ordering::greater : std::partial_ordering::less;
-                        break;
-                    }
-                }
-                return o < 0;
-            });
-        }
+        if (realSort)
+            m_sortedLots = sortLotsByKeys(columns);
     }
 
     // we were filtered before, but we don't want to re-filter: the solution is to
@@ -2539,36 +2839,276 @@ void DocumentModel::sortDirect(const QVector<QPair<int, Qt::SortOrder>> &columns
         emit isSortedChanged(isSorted());
 }
 
-void DocumentModel::filterDirect(const QVector<Filter> &filter, bool &filtered,
-                            LotList &unfilteredLots)
+static QVector<QPair<int, Qt::SortOrder>> sortColumnsPlusIndex(const QVector<QPair<int, Qt::SortOrder>> &columns)
 {
-    bool emitFilterChanged = (filter != m_filter);
-    bool wasFiltered = isFiltered();
-    qsizetype filteredSizeBefore = m_filteredLots.size();
+    // make the sort deterministic
+    auto columnsPlusIndex = columns;
+    bool needIndex = true;
+    for (const auto &[columnIndex, sortOrder] : columns) {
+        if (columnIndex == 0) {
+            needIndex = false;
+            break;
+        }
+    }
+    if (needIndex) {
+        columnsPlusIndex.append(qMakePair(0, columns.isEmpty() ? Qt::AscendingOrder
+                                                               : columns.constFirst().second));
+    }
+    return columnsPlusIndex;
+}
+
+std::function<bool(const Lot *, const Lot *)> DocumentModel::sortLessThan(const QVector<QPair<int, Qt::SortOrder>> &columns) const
+{
+    // same collation as the sort keys in sortLotsByKeys()
+    return [this, columnsPlusIndex = sortColumnsPlusIndex(columns), collator = QCollator { }]
+            (const auto *lot1, const auto *lot2) {
+        std::partial_ordering o = std::partial_ordering::equivalent;
+        for (const auto &[columnIndex, sortOrder] : columnsPlusIndex) {
+            const auto &column = m_columns.value(columnIndex);
+
+            if (column.compareFn) {
+                o = column.compareFn(lot1, lot2);
+            } else if (column.dataFn) {
+                const auto v1 = column.dataFn(lot1);
+                const auto v2 = column.dataFn(lot2);
+
+                // Qt (as of 6.5.0) does not support operator<=> on QVariant yet
+                switch (column.type) {
+                case Column::Type::String:
+                    o = collator.compare(v1.toString(), v2.toString()) <=> 0; break;
+                case Column::Type::Integer:
+                case Column::Type::NonLocalizedInteger:
+                case Column::Type::Enum:
+                    o = v1.toLongLong() <=> v2.toLongLong(); break;
+                case Column::Type::Currency:
+                case Column::Type::Weight:
+                    o = Utility::fuzzyCompare(v1.toDouble(), v2.toDouble()); break;
+                case Column::Type::Date:
+                    o = v1.toDateTime().toSecsSinceEpoch() <=> v2.toDateTime().toSecsSinceEpoch(); break;
+                case Column::Type::Special:
+                    o = std::partial_ordering::equivalent; break;
+                default:
+                    o = std::partial_ordering::unordered; break;
+                }
+            }
+            if (o != 0) {
+                if (sortOrder == Qt::DescendingOrder)
+                    o = (o < 0) ? std::partial_ordering::greater : std::partial_ordering::less;
+                break;
+            }
+        }
+        return o < 0;
+    };
+}
 
-    emit layoutAboutToBeChanged({ }, VerticalSortHint);
-    const QModelIndexList before = persistentIndexList();
+QVector<Lot *> DocumentModel::sortLotsByKeys(const QVector<QPair<int, Qt::SortOrder>> &columns) const
+{
+    // Extract the sort keys of all lots once upfront into plain arrays and sort a permutation
+    // of m_lots: the comparator would otherwise call dataFn and collate strings 2 * n * log(n)
+    // times. Columns with a compareFn still need to compare the actual lots.
 
-    m_filter = filter;
+    struct SortKeys {
+        enum { Lots, Int, Double, String } type;
+        Qt::SortOrder order;
+        std::function<std::partial_ordering(const Lot *, const Lot *)> compareFn = { };
+        std::vector<qint64> ints = { };
+        std::vector<double> doubles = { };
+        std::vector<QCollatorSortKey> strings = { };
+    };
 
-    if (!unfilteredLots.isEmpty()) {
-        m_isFiltered = filtered;
-        m_filteredLots = unfilteredLots;
-        unfilteredLots.clear();
+    const auto lotCount = m_lots.size();
+    std::vector<SortKeys> keys;
 
-    } else {
-        unfilteredLots = m_filteredLots;
-        filtered = m_isFiltered;
-        m_isFiltered = true;
-        m_filteredLots = m_sortedLots;
+    for (const auto &[columnIndex, sortOrder] : sortColumnsPlusIndex(columns)) {
+        auto it = m_columns.constFind(columnIndex);
+        if (it == m_columns.cend())
+            continue;
+        const auto &column = *it;
+
+        if (columnIndex == Index) {
+            // the index column is compared via m_lotIndex, which is the position in m_lots
+            SortKeys k { SortKeys::Int, sortOrder };
+            k.ints.resize(size_t(lotCount));
+            std::iota(k.ints.begin(), k.ints.end(), 0);
+            keys.push_back(std::move(k));
+
+        } else if (column.compareFn) {
+            keys.push_back({ SortKeys::Lots, sortOrder, column.compareFn });
+
+        } else if (column.dataFn) {
+            SortKeys k { SortKeys::Int, sortOrder };
+
+            switch (column.type) {
+            case Column::Type::String: {
+                k.type = SortKeys::String;
+                k.strings.reserve(size_t(lotCount));
+                QCollator collator;
+                for (const Lot *lot : m_lots)
+                    k.strings.push_back(collator.sortKey(column.dataFn(lot).toString()));
+                break;
+            }
+            case Column::Type::Integer:
+            case Column::Type::NonLocalizedInteger:
+            case Column::Type::Enum:
+                k.ints.reserve(size_t(lotCount));
+                for (const Lot *lot : m_lots)
+                    k.ints.push_back(column.dataFn(lot).toLongLong());
+                break;
+            case Column::Type::Currency:
+            case Column::Type::Weight:
+                k.type = SortKeys::Double;
+                k.doubles.reserve(size_t(lotCount));
+                for (const Lot *lot : m_lots)
+                    k.doubles.push_back(column.dataFn(lot).toDouble());
+                break;
+            case Column::Type::Date:
+                k.ints.reserve(size_t(lotCount));
+                for (const Lot *lot : m_lots)
+                    k.ints.push_back(column.dataFn(lot).toDateTime().toSecsSinceEpoch());
+                break;
+            default:
+                continue; // always equivalent
+            }
+            keys.push_back(std::move(k));
+        }
+    }
+
+    std::vector<qsizetype> order(size_t(lotCount));
+    std::iota(order.begin(), order.end(), 0);
+
+    qParallelSort(order.begin(), order.end(), [this, &keys](qsizetype i1, qsizetype i2) {
+        for (const auto &k : keys) {
+            std::partial_ordering o = std::partial_ordering::equivalent;
+
+            switch (k.type) {
+            case SortKeys::Lots:
+                o = k.compareFn(m_lots.at(i1), m_lots.at(i2)); break;
+            case SortKeys::Int:
+                o = k.ints[size_t(i1)] <=> k.ints[size_t(i2)]; break;
+            case SortKeys::Double:
+                o = Utility::fuzzyCompare(k.doubles[size_t(i1)], k.doubles[size_t(i2)]); break;
+            case SortKeys::String:
+                o = k.strings[size_t(i1)].compare(k.strings[size_t(i2)]) <=> 0; break;
+            }
+            if (o != 0)
+                return (k.order == Qt::DescendingOrder) ? (o > 0) : (o < 0);
+        }
+        return false;
+    });
+
+    QVector<Lot *> sortedLots;
+    sortedLots.reserve(lotCount);
+    for (const auto i : order)
+        sortedLots.append(m_lots.at(i));
+    return sortedLots;
+}
+
+void DocumentModel::sortChangedLotsDirect(const QSet<const Lot *> &changedLots)
+{
+    const auto lessThan = sortLessThan(m_sortColumns);
 
-        if (!filter.isEmpty()) {
-            m_filteredLots = QtConcurrent::blockingFiltered(m_sortedLots, [this](auto *lot) {
-                return filterAcceptsLot(lot);
-            });
+    // all the lots that didn't change are still sorted
+    QVector<Lot *> unchangedLots;
+    unchangedLots.reserve(m_sortedLots.size());
+    std::vector<std::pair<qsizetype, Lot *>> changed; // new position in unchangedLots, lot
+    changed.reserve(size_t(changedLots.size()));
+
+    for (Lot *lot : std::as_const(m_sortedLots)) {
+        if (changedLots.contains(lot))
+            changed.emplace_back(0, lot);
+        else
+            unchangedLots.append(lot);
+    }
+    for (auto &[pos, lot] : changed)
+        pos = std::upper_bound(unchangedLots.cbegin(), unchangedLots.cend(), lot, lessThan) - unchangedLots.cbegin();
+
+    std::sort(changed.begin(), changed.end(), [&lessThan](const auto &c1, const auto &c2) {
+        return (c1.first != c2.first) ? (c1.first < c2.first) : lessThan(c1.second, c2.second);
+    });
+
+    m_sortedLots.clear();
+    m_sortedLots.reserve(unchangedLots.size() + qsizetype(changed.size()));
+    auto it = changed.cbegin();
+    for (qsizetype i = 0; i <= unchangedLots.size(); ++i) {
+        while ((it != changed.cend()) && (it->first == i))
+            m_sortedLots.append((it++)->second);
+        if (i < unchangedLots.size())
+            m_sortedLots.append(unchangedLots.at(i));
+    }
+
+    // keep the old filtered lots, but use the order from m_sortedLots
+    QVector<Lot *> filteredLots = m_sortedLots;
+    if (m_filteredLots.size() != m_sortedLots.size()) {
+        filteredLots = QtConcurrent::blockingFiltered(m_sortedLots, [this](auto *lot) {
+            return m_filteredLotIndex.contains(lot);
+        });
+    }
+    updateFilteredLots(filteredLots, changedLots);
+}
+
+void DocumentModel::updateFilteredLots(const QVector<Lot *> &filteredLots,
+                                       const QSet<const Lot *> &changedLots)
+{
+    // above this, a single layout change is cheaper for the views than lots of row moves
+    static constexpr qsizetype MaxRowChanges = 100;
+
+    // only the changed lots are allowed to be moved, inserted or removed
+    std::vector<std::pair<qsizetype, Lot *>> changed; // position in filteredLots, lot
+    if (changedLots.size() <= MaxRowChanges) {
+        for (qsizetype i = 0; i < filteredLots.size(); ++i) {
+            if (changedLots.contains(filteredLots.at(i)))
+                changed.emplace_back(i, filteredLots.at(i));
+        }
+    }
+
+    if ((changedLots.size() <= MaxRowChanges) && (changed.size() <= size_t(MaxRowChanges))) {
+        auto updateIndex = [this](qsizetype from, qsizetype to) {
+            for (auto i = from; i <= to; ++i)
+                m_filteredLotIndex[m_filteredLots.at(i)] = int(i);
+        };
+
+        // remove the lots that are not visible anymore
+        for (const Lot *lot : changedLots) {
+            const int row = m_filteredLotIndex.value(lot, -1);
+            if ((row < 0) || std::any_of(changed.cbegin(), changed.cend(),
+                                         [lot](const auto &c) { return c.second == lot; })) {
+                continue;
+            }
+            beginRemoveRows({ }, row, row);
+            m_filteredLots.removeAt(row);
+            m_filteredLotIndex.remove(lot);
+            updateIndex(row, m_filteredLots.size() - 1);
+            endRemoveRows();
+        }
+
+        // every changed lot has to end up right behind its new predecessor: doing this in the
+        // new order guarantees that the predecessor is already at its final place
+        for (const auto &[pos, lot] : changed) {
+            const int destRow = (pos > 0) ? (m_filteredLotIndex.value(filteredLots.at(pos - 1), -1) + 1) : 0;
+            const int row = m_filteredLotIndex.value(lot, -1);
+
+            if (row < 0) {
+                beginInsertRows({ }, destRow, destRow);
+                m_filteredLots.insert(destRow, lot);
+                updateIndex(destRow, m_filteredLots.size() - 1);
+                endInsertRows();
+            } else if ((row != destRow) && (row + 1 != destRow)) {
+                beginMoveRows({ }, row, row, { }, destRow);
+                m_filteredLots.move(row, (row < destRow) ? (destRow - 1) : destRow);
+                updateIndex(std::min(row, destRow), std::max(row, destRow - 1));
+                endMoveRows();
+            }
         }
+
+        // the unchanged lots should have kept their relative order, but better safe than sorry
+        if (m_filteredLots == filteredLots)
+            return;
     }
 
+    emit layoutAboutToBeChanged({ }, VerticalSortHint);
+    const QModelIndexList before = persistentIndexList();
+
+    m_filteredLots = filteredLots;
     rebuildFilteredLotIndex();
 
     QModelIndexList after;
@@ -2577,6 +3117,65 @@ void DocumentModel::filterDirect(const QVector<Filter> &filter, bool &filtered,
         after.append(index(lot(idx), idx.column()));
     changePersistentIndexList(before, after);
     emit layoutChanged({ }, VerticalSortHint);
+}
+
+void DocumentModel::filterDirect(const QVector<Filter> &filter, bool &filtered,
+                            LotList &unfilteredLots)
+{
+    bool emitFilterChanged = (filter != m_filter);
+    bool wasFiltered = isFiltered();
+    qsizetype filteredSizeBefore = m_filteredLots.size();
+
+    // if only a few lots changed since the last filter run, we just need to re-check those
+    if (unfilteredLots.isEmpty() && !emitFilterChanged && m_changedSinceFilter
+            && (m_changedSinceFilter->size() <= (m_sortedLots.size() / 4))) {
+        unfilteredLots = m_filteredLots;
+        filtered = m_isFiltered;
+        m_isFiltered = true;
+
+        const auto &changedLots = *m_changedSinceFilter;
+        auto filteredLots = QtConcurrent::blockingFiltered(m_sortedLots, [this, &changedLots](auto *lot) {
+            return changedLots.contains(lot) ? filterAcceptsLot(lot) : m_filteredLotIndex.contains(lot);
+        });
+        updateFilteredLots(filteredLots, changedLots);
+        m_changedSinceFilter.emplace();
+
+    } else {
+        emit layoutAboutToBeChanged({ }, VerticalSortHint);
+        const QModelIndexList before = persistentIndexList();
+
+        m_filter = filter;
+        compileFilter();
+
+        if (!unfilteredLots.isEmpty()) {
+            m_isFiltered = filtered;
+            m_filteredLots = unfilteredLots;
+            unfilteredLots.clear();
+            m_changedSinceFilter.reset();
+
+        } else {
+            unfilteredLots = m_filteredLots;
+            filtered = m_isFiltered;
+            m_isFiltered = true;
+            m_filteredLots = m_sortedLots;
+            m_changedSinceFilter.emplace();
+
+            if (!filter.isEmpty()) {
+                m_filteredLots = QtConcurrent::blockingFiltered(m_sortedLots, [this](auto *lot) {
+                    return filterAcceptsLot(lot);
+                });
+            }
+        }
+
+        rebuildFilteredLotIndex();
+
+        QModelIndexList after;
+        after.reserve(before.size());
+        for (const QModelIndex &idx : before)
+            after.append(index(lot(idx), idx.column()));
+        changePersistentIndexList(before, after);
+        emit layoutChanged({ }, VerticalSortHint);
+    }
 
     if (emitFilterChanged)
         emit filterChanged(filter);
@@ -2589,6 +3188,24 @@ void DocumentModel::filterDirect(const QVector<Filter> &filter, bool &filtered,
         emit filteredLotCountChanged(int(filteredSizeNow));
 }
 
+void DocumentModel::trackChangedLot(const Lot *lot, bool removed)
+{
+    for (auto *changedLots : { &m_changedSinceSort, &m_changedSinceFilter }) {
+        if (!*changedLots)
+            continue;
+        if (removed)
+            (*changedLots)->remove(lot);
+        else
+            (*changedLots)->insert(lot);
+    }
+}
+
+void DocumentModel::resetChangedLotTracking()
+{
+    m_changedSinceSort.reset();
+    m_changedSinceFilter.reset();
+}
+
 QByteArray DocumentModel::saveSortFilterState() const
 {
     QByteArray ba;
@@ -2748,22 +3365,13 @@ void DocumentModel::reFilter()
 }
 
 
-bool DocumentModel::filterAcceptsLot(const Lot *lot) const
+void DocumentModel::compileFilter()
 {
-    if (!lot)
-        return false;
-    else if (m_filter.isEmpty())
-        return true;
-
-    bool filterResult = false;
-    Filter::Combination nextcomb = Filter::Or;
+    m_compiledFilter.clear();
+    m_compiledFilter.reserve(size_t(m_filter.size()));
 
     for (const Filter &f : m_filter) {
-        // short circuit
-        if (((nextcomb == Filter::And) && !filterResult) || ((nextcomb == Filter::Or) && filterResult)) {
-            nextcomb = f.combination();
-            continue;
-        }
+        CompiledFilter cf { f.combination(), { } };
 
         int firstcol = f.field();
         int lastcol = firstcol;
@@ -2771,159 +3379,210 @@ bool DocumentModel::filterAcceptsLot(const Lot *lot) const
             firstcol = 0;
             lastcol = columnCount() - 1;
         }
+        for (int col = firstcol; col <= lastcol; ++col) {
+            auto it = m_columns.constFind(col);
+            if ((it == m_columns.cend()) || !it->filterable)
+                continue;
+            cf.matchers.push_back(compileFilterMatcher(f, *it));
+        }
+        m_compiledFilter.push_back(std::move(cf));
+    }
+}
 
-        bool rowResult = false;
-        for (int col = firstcol; col <= lastcol && !rowResult; ++col) {
-            const auto field = static_cast<Field>(col);
-            const auto &c = m_columns.value(field);
+std::function<bool(const Lot *)> DocumentModel::compileFilterMatcher(const Filter &f, const Column &c)
+{
+    const QString s1 = f.expression();
+    const auto comparison = f.comparison();
 
-            if (!c.filterable)
-                continue;
+    bool displayTextMatch = true;
+    switch (comparison) {
+    case Filter::Is:
+    case Filter::IsNot:
+    case Filter::Less:
+    case Filter::GreaterEqual:
+    case Filter::Greater:
+    case Filter::LessEqual:
+        displayTextMatch = false;
+        break;
+    default:
+        break;
+    }
 
-            bool displayTextMatch = true;
-            switch (f.comparison()) {
-            case Filter::Is:
-            case Filter::IsNot:
-            case Filter::Less:
-            case Filter::GreaterEqual:
-            case Filter::Greater:
-            case Filter::LessEqual:
-                displayTextMatch = false;
-                break;
-            default:
-                break;
-            }
+    if (displayTextMatch) {
+        // display text based filters
 
-            const QString s1 = f.expression();
-            QString s2 = dataForDisplayRole(lot, field, false);
+        if (s1.isEmpty())
+            return [](const Lot *) { return true; };
 
-            if (displayTextMatch) {
-                // display text based filters
+        std::function<bool(const QString &)> textMatch;
 
-                if (c.type == Column::Type::Enum) {
-                    // the display role for enums might be empty
-                    qint64 e = dataForEditRole(lot, field).toLongLong();
-                    for (const auto &[value, tooltip, filter] : c.enumValues) {
-                        if (e == value) {
-                            s2 = filter;
-                            break;
-                        }
-                    }
-                }
+        switch (comparison) {
+        case Filter::StartsWith:
+            textMatch = [s1](const QString &s2) { return s2.startsWith(s1, Qt::CaseInsensitive); };
+            break;
+        case Filter::DoesNotStartWith:
+            textMatch = [s1](const QString &s2) { return !s2.startsWith(s1, Qt::CaseInsensitive); };
+            break;
+        case Filter::EndsWith:
+            textMatch = [s1](const QString &s2) { return s2.endsWith(s1, Qt::CaseInsensitive); };
+            break;
+        case Filter::DoesNotEndWith:
+            textMatch = [s1](const QString &s2) { return !s2.endsWith(s1, Qt::CaseInsensitive); };
+            break;
+        case Filter::Matches:
+        case Filter::DoesNotMatch: {
+            const bool negate = (comparison == Filter::DoesNotMatch);
+            if (f.is<QRegularExpression>()) {
+                // We are using QRegularExpressions in multiple threads here, although the class is not
+                // marked thread-safe. We are relying on the const match() function to be thread-safe,
+                // which it currently is up to Qt 6.2.
+
+                textMatch = [re = f.as<QRegularExpression>(), negate](const QString &s2) {
+                    return re.match(s2).hasMatch() != negate;
+                };
+            } else {
+                textMatch = [matcher = QStringMatcher(s1, Qt::CaseInsensitive), negate](const QString &s2) {
+                    return (matcher.indexIn(s2) >= 0) != negate;
+                };
+            }
+            break;
+        }
+        default:
+            return [](const Lot *) { return false; };
+        }
 
-                switch (f.comparison()) {
-                case Filter::StartsWith:
-                    rowResult = s1.isEmpty() || s2.startsWith(s1, Qt::CaseInsensitive); break;
-                case Filter::DoesNotStartWith:
-                    rowResult = s1.isEmpty() || !s2.startsWith(s1, Qt::CaseInsensitive); break;
-                case Filter::EndsWith:
-                    rowResult = s1.isEmpty() || s2.endsWith(s1, Qt::CaseInsensitive); break;
-                case Filter::DoesNotEndWith:
-                    rowResult = s1.isEmpty() || !s2.endsWith(s1, Qt::CaseInsensitive); break;
-                case Filter::Matches:
-                case Filter::DoesNotMatch: {
-                    if (s1.isEmpty()) {
-                        rowResult = true; break;
-                    } else if (f.is<QRegularExpression>()) {
-                        // We are using QRegularExpressions in multiple threads here, although the class is not
-                        // marked thread-safe. We are relying on the const match() function to be thread-safe,
-                        // which it currently is up to Qt 6.2.
-
-                        bool res = f.as<QRegularExpression>().match(s2).hasMatch();
-                        rowResult = (f.comparison() == Filter::Matches) ? res : !res; break;
-                    } else {
-                        bool res = s2.contains(s1, Qt::CaseInsensitive);
-                        rowResult = (f.comparison() == Filter::Matches) ? res : !res; break;
-                    }
-                }
-                default:
+        if (c.type == Column::Type::Enum) {
+            // the display role for enums might be empty, but the filter texts are fixed, so we can
+            // match them right now
+            QHash<qint64, bool> enumMatches;
+            for (const auto &[value, tooltip, filter] : c.enumValues) {
+                if (!enumMatches.contains(value))
+                    enumMatches.insert(value, textMatch(filter));
+            }
+            return [c, textMatch, enumMatches](const Lot *lot) {
+                const qint64 e = c.dataFn ? c.dataFn(lot).toLongLong() : 0;
+                if (auto it = enumMatches.constFind(e); it != enumMatches.cend())
+                    return *it;
+                return textMatch(dataForDisplayRole(c, lot, false));
+            };
+        }
+        return [c, textMatch](const Lot *lot) {
+            return textMatch(dataForDisplayRole(c, lot, false));
+        };
+
+    } else {
+        // data based filters
+
+        auto compareInt = [comparison](qint64 i2, qint64 i1) {
+            switch (comparison) {
+            case Filter::Is:           return i2 == i1;
+            case Filter::IsNot:        return i2 != i1;
+            case Filter::Less:         return i2 < i1;
+            case Filter::LessEqual:    return i2 <= i1;
+            case Filter::Greater:      return i2 > i1;
+            case Filter::GreaterEqual: return i2 >= i1;
+            default:                   return false;
+            }
+        };
+        // only Is and IsNot can match non-numeric values, so we can skip the display text otherwise
+        auto compareText = [comparison, s1](const Column &c, const Lot *lot) {
+            switch (comparison) {
+            case Filter::Is:    return dataForDisplayRole(c, lot, false).compare(s1, Qt::CaseInsensitive) == 0;
+            case Filter::IsNot: return dataForDisplayRole(c, lot, false).compare(s1, Qt::CaseInsensitive) != 0;
+            default:            return false;
+            }
+        };
+
+        if (c.type == Column::Type::Enum) {
+            qint64 i1 = -1;
+            for (const auto &[value, tooltip, filter] : c.enumValues) {
+                if (s1 == filter) {
+                    i1 = value;
                     break;
                 }
-            } else {
-                // data based filters
-                QVariant v = dataForEditRole(lot, field);
-                if (v.isNull())
-                    v = s2;
-
-                bool isInt = false;
-                qint64 i1 = 0, i2 = 0;
-
-                if (c.type == Column::Type::Enum) {
-                    i1 = -1;
-                    for (const auto &[value, tooltip, filter] : c.enumValues) {
-                        if (s1 == filter) {
-                            i1 = value;
-                            break;
-                        }
-                    }
-                    i2 = v.toLongLong();
-                    isInt = true;
+            }
+            return [c, i1, compareInt](const Lot *lot) {
+                QVariant v = c.dataFn ? c.dataFn(lot) : QVariant { };
+                const qint64 i2 = v.isNull() ? dataForDisplayRole(c, lot, false).toLongLong()
+                                             : v.toLongLong();
+                return compareInt(i2, i1);
+            };
+        }
 
-                } else {
-                    switch (v.userType()) {
-                    case QMetaType::Int:
-                    case QMetaType::UInt:
-                    case QMetaType::LongLong:
-                    case QMetaType::ULongLong: {
-                        if (f.is<int>()) {
-                            i1 = f.as<int>();
-                            i2 = v.toInt();
-                            isInt = true;
-                        }
-                        break;
-                    }
-                    case QMetaType::Double: {
-                        if (f.is<double>()) {
-                            i1 = qRound64(f.as<double>() * 1000.);
-                            i2 = qRound64(v.toDouble() * 1000.);
-                            isInt = true;
-                        }
-                        break;
-                    }
-                    case QMetaType::QDateTime: {
-                        if (auto dt = f.as<QDateTime>(); dt.isValid()) {
-                            if (f.is<QDate>()) {
-                                // just compare the date, not the time
-                                i1 = dt.toLocalTime().date().toJulianDay();
-                                i2 = v.toDateTime().toLocalTime().date().toJulianDay();
-                            } else {
-                                // round down to the nearest minute
-                                i1 = dt.addSecs(-dt.time().second()).toSecsSinceEpoch();
-                                i2 = v.toDateTime().addSecs(-v.toDateTime().time().second()).toSecsSinceEpoch();
-                            }
-                            isInt = true;
-                        }
-                        break;
-                    }
-                    default:
-                        break;
-                    }
-                }
+        // pre-convert the expression for every value type the column might return
+        const bool hasInt = f.is<int>();
+        const qint64 intValue = hasInt ? f.as<int>() : 0;
+        const bool hasDouble = f.is<double>();
+        const qint64 doubleValue = hasDouble ? qRound64(f.as<double>() * 1000.) : 0;
+        const QDateTime dt = f.as<QDateTime>();
+        const bool hasDateTime = dt.isValid();
+        const bool dateOnly = f.is<QDate>();
+        qint64 dateTimeValue = 0;
+        if (hasDateTime) {
+            if (dateOnly) // just compare the date, not the time
+                dateTimeValue = dt.toLocalTime().date().toJulianDay();
+            else // round down to the nearest minute
+                dateTimeValue = dt.addSecs(-dt.time().second()).toSecsSinceEpoch();
+        }
 
-                switch (f.comparison()) {
-                case Filter::Is:
-                    rowResult = isInt ? i2 == i1 : s2.compare(s1, Qt::CaseInsensitive) == 0; break;
-                case Filter::IsNot:
-                    rowResult = isInt ? i2 != i1 : s2.compare(s1, Qt::CaseInsensitive) != 0; break;
-                case Filter::Less:
-                    rowResult = isInt ? i2 < i1 : false; break;
-                case Filter::LessEqual:
-                    rowResult = isInt ? i2 <= i1 : false; break;
-                case Filter::Greater:
-                    rowResult = isInt ? i2 > i1 : false; break;
-                case Filter::GreaterEqual:
-                    rowResult = isInt ? i2 >= i1 : false; break;
-                default:
-                    break;
+        return [=](const Lot *lot) {
+            QVariant v = c.dataFn ? c.dataFn(lot) : QVariant { };
+
+            switch (v.isNull() ? QMetaType::UnknownType : v.userType()) {
+            case QMetaType::Int:
+            case QMetaType::UInt:
+            case QMetaType::LongLong:
+            case QMetaType::ULongLong:
+                if (hasInt)
+                    return compareInt(v.toInt(), intValue);
+                break;
+            case QMetaType::Double:
+                if (hasDouble)
+                    return compareInt(qRound64(v.toDouble() * 1000.), doubleValue);
+                break;
+            case QMetaType::QDateTime:
+                if (hasDateTime) {
+                    const QDateTime vdt = v.toDateTime();
+                    if (dateOnly)
+                        return compareInt(vdt.toLocalTime().date().toJulianDay(), dateTimeValue);
+                    else
+                        return compareInt(vdt.addSecs(-vdt.time().second()).toSecsSinceEpoch(), dateTimeValue);
                 }
+                break;
+            default:
+                break;
             }
+            return compareText(c, lot);
+        };
+    }
+}
+
+bool DocumentModel::filterAcceptsLot(const Lot *lot) const
+{
+    if (!lot)
+        return false;
+    else if (m_compiledFilter.empty())
+        return true;
+
+    bool filterResult = false;
+    Filter::Combination nextcomb = Filter::Or;
+
+    for (const CompiledFilter &cf : m_compiledFilter) {
+        // short circuit
+        if (((nextcomb == Filter::And) && !filterResult) || ((nextcomb == Filter::Or) && filterResult)) {
+            nextcomb = cf.combination;
+            continue;
         }
+
+        const bool rowResult = std::any_of(cf.matchers.cbegin(), cf.matchers.cend(),
+                                           [lot](const auto &matcher) { return matcher(lot); });
+
         if (nextcomb == Filter::And)
             filterResult = filterResult && rowResult;
         else
             filterResult = filterResult || rowResult;
 
-        nextcomb = f.combination();
+        nextcomb = cf.combination;
     }
     return filterResult;
 }
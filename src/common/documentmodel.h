@@ -4,8 +4,10 @@
 #pragma once
 
 #include <functional>
+#include <optional>
 
 #include <QAbstractTableModel>
+#include <QSet>
 #include <QPixmap>
 #include <QUuid>
 #include <QTimer>
@@ -289,6 +291,7 @@ public:
         LotDidNotChange = 0,
     };
 
+    // the callback may be run in parallel on different lots: it must not touch any shared state
     void applyTo(const LotList &lots, const std::function<ApplyToResult(const Lot &, Lot &)> &callback,
                  const QString &actionText = { });
 
@@ -324,21 +327,34 @@ private:
     void setFakeIndexes(const QVector<int> &fakeIndexes);
     void rebuildLotIndex();
     void rebuildFilteredLotIndex();
+    void rebuildLotColumns();
+    void updateLotColumns(const Lot *lot);
 
     void setLotsDirect(const LotList &lots);
     void insertLotsDirect(const LotList &lots, QVector<int> &positions, QVector<int> &sortedPositions, QVector<int> &filteredPositions);
     void removeLotsDirect(const LotList &lots, QVector<int> &positions, QVector<int> &sortedPositions, QVector<int> &filteredPositions);
-    void changeLotsDirect(std::vector<std::pair<Lot *, Lot> > &changes);
+    void changeLotsDirect(const LotList &lots, const QVector<Lot::DeltaFields> &fields, QByteArray &values);
+    void limitUndoMemory();
+    void discardUndoHistory();
     void changeCurrencyDirect(const QString &ccode, double crate, double *&prices);
     void resetDifferenceModeDirect(QHash<const Lot *, Lot>
                                    &differenceBase);
     void filterDirect(const QVector<Filter> &filterList, bool &filtered,
                       LotList &unfiltered);
     void sortDirect(const QVector<QPair<int, Qt::SortOrder>> &columns, bool &sorted, LotList &unsorted);
+    void sortChangedLotsDirect(const QSet<const Lot *> &changedLots);
+    void updateFilteredLots(const QVector<Lot *> &filteredLots, const QSet<const Lot *> &changedLots);
+    std::function<bool(const Lot *, const Lot *)> sortLessThan(const QVector<QPair<int, Qt::SortOrder>> &columns) const;
+    QVector<Lot *> sortLotsByKeys(const QVector<QPair<int, Qt::SortOrder>> &columns) const;
+
+    void trackChangedLot(const Lot *lot, bool removed = false);
+    void resetChangedLotTracking();
 
     void emitDataChanged(const QModelIndex &tl = { }, const QModelIndex &br = { });
     void emitStatisticsChanged();
+    QPair<quint64, quint64> calculateLotFlags(const Lot *lot) const;
     void updateLotFlags(const Lot *lot);
+    void updateLotFlags(const LotList &lots);
     void setLotFlags(const Lot *lot, quint64 errors, quint64 updated);
 
     void updateModified();
@@ -353,6 +369,7 @@ private:
     friend class SortCmd;
     friend class FilterCmd;
     friend class ResetDifferenceModeCmd;
+    friend class DocumentStatistics;
 
 private:
     struct Column {
@@ -376,6 +393,35 @@ private:
     };
     QHash<int, Column> m_columns;
 
+    static QString dataForDisplayRole(const Column &c, const Lot *lot, bool asToolTip);
+
+    // all the fields compared by canLotsBeMerged()
+    struct MergeKey {
+        const BrickLink::Item *item;
+        const BrickLink::Color *color;
+        BrickLink::Condition condition;
+        BrickLink::SubCondition subCondition;
+        bool excluded;
+
+        bool operator==(const MergeKey &other) const = default;
+        friend size_t qHash(const MergeKey &key, size_t seed = 0)
+        {
+            return qHashMulti(seed, key.item, key.color, uint(key.condition), uint(key.subCondition),
+                              key.excluded);
+        }
+    };
+    static std::optional<MergeKey> mergeKey(const Lot *lot); // nullopt if it can never be merged
+
+    // m_filter, compiled into one predicate per filterable column
+    struct CompiledFilter {
+        Filter::Combination combination;
+        std::vector<std::function<bool(const Lot *)>> matchers;
+    };
+    std::vector<CompiledFilter> m_compiledFilter;
+
+    void compileFilter();
+    static std::function<bool(const Lot *)> compileFilterMatcher(const Filter &f, const Column &c);
+
     QVector<Lot *> m_lots;
     QVector<Lot *> m_sortedLots;
     QVector<Lot *> m_filteredLots;
@@ -383,6 +429,25 @@ private:
     mutable QHash<const Lot *, int> m_lotIndex;
     mutable QHash<const Lot *, int> m_filteredLotIndex;
 
+    // The numeric lot fields needed for the statistics as a structure of arrays, in m_lots
+    // order: summing these up doesn't need to touch the Lot objects at all.
+    struct LotColumns {
+        std::vector<int> quantity;
+        std::vector<double> price;
+        std::vector<double> minPrice; // lowest tier price, minus the sale
+        std::vector<double> cost;
+        std::vector<double> totalWeight;
+        std::vector<quint64> errors;      // unmasked
+        std::vector<quint64> differences; // unmasked
+        std::vector<quint8> excluded;
+        std::vector<quint8> incomplete;
+
+        void resize(size_t size);
+        void set(size_t row, const Lot *lot);
+        static double minPrice(const Lot *lot);
+    };
+    LotColumns m_lotColumns;
+
     QHash<const Lot *, Lot> m_differenceBase;
     QVector<int>     m_fakeIndexes; // for the consolidate dialogs
     QHash<const Lot *, QPair<quint64, quint64>> m_lotFlags;
@@ -394,6 +459,11 @@ private:
     bool m_isSorted = false;   // freshly sorted, no changes
     bool m_isFiltered = false; // freshly filtered, no changes
 
+    // the lots changed since the last sort/filter run: only these need to be re-evaluated on
+    // reSort() and reFilter() (nullopt: we lost track and need to do a full run)
+    std::optional<QSet<const Lot *>> m_changedSinceSort;
+    std::optional<QSet<const Lot *>> m_changedSinceFilter;
+
     QString          m_currencycode;
     QPair<quint64, quint64> m_lotFlagsMask = { 0, 0 };
 
@@ -403,6 +473,7 @@ private:
     UndoStack *      m_undo = nullptr;
     int m_firstNonVisualIndex = 0;
     bool m_visuallyClean = true;
+    bool m_discardingUndoHistory = false;
 
     QTimer *          m_delayedEmitOfStatisticsChanged = nullptr;
     QTimer *          m_delayedEmitOfDataChanged = nullptr;
@@ -3,8 +3,11 @@
 
 #pragma once
 
+#include <memory>
+
 #include <QUndoCommand>
 #include <QPointer>
+#include <QTemporaryFile>
 
 #include "documentmodel.h"
 
@@ -45,13 +48,22 @@ public:
     void redo() override;
     void undo() override;
 
+    qsizetype memoryUsage() const;
+    void spill();
+
 private:
     void updateText();
+    bool loadValues(QByteArray &values) const;
 
     DocumentModel *m_model;
     uint m_loopCount;
     DocumentModel::Field m_hint;
-    std::vector<std::pair<Lot *, Lot>> m_changes;
+    // sorted by pointer: m_values has the differing fields of every lot, streamed in this order
+    LotList m_lots;
+    QVector<Lot::DeltaFields> m_fields;
+    QByteArray m_values;
+    std::unique_ptr<QTemporaryFile> m_spillFile; // holds m_values, if it was moved out of memory
+    qsizetype m_spilledSize = 0;
 
     static QTimer *s_eventLoopCounter;
 };
@@ -161,6 +161,7 @@ Item {
                     required property RenderGeometry modelData
 
                     geometry: modelData
+                    instancing: modelData ? modelData.instancing : null
                     materials: PrincipledMaterial {
                         id: material
                         property color color       : model.modelData ? model.modelData.color : "pink"
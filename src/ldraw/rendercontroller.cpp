@@ -1,6 +1,7 @@
 // Copyright (C) 2004-2025 Robert Griebl
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
 #include <cmath>
 
 #include <QtConcurrent>
@@ -15,6 +16,7 @@
 #include <QCoro/QCoroFuture>
 
 #include "bricklink/core.h"
+#include "bricklink/database.h"
 #include "library.h"
 #include "part.h"
 #include "rendercontroller.h"
@@ -25,6 +27,62 @@ namespace LDraw {
 
 QHash<const BrickLink::Color *, QImage> RenderController::s_materialTextureDatas;
 
+// sub-parts used at least this often are drawn instanced
+static constexpr int MinInstanceCount = 16;
+
+// the cache cost is in KB
+static constexpr int MaxRenderDataCacheCost = 64 * 1024;
+
+static const BrickLink::Color *mapColor(int colorId)
+{
+    auto c = BrickLink::core()->colorFromLDrawId(colorId);
+    if (!c && colorId >= 256) {
+        int newColorId = ((colorId - 256) & 0x0f);
+        qCWarning(LogLDraw) << "Dithered colors are not supported, using only one:"
+                            << colorId << "->" << newColorId;
+        c = BrickLink::core()->colorFromLDrawId(newColorId);
+    }
+    if (!c) {
+        qCWarning(LogLDraw) << "Could not map LDraw color" << colorId;
+        c = BrickLink::core()->color(9 /*light gray*/);
+    }
+    return c;
+}
+
+// Appends all points (xyz) in src to dst, after transforming them with the affine matrix m.
+// Written as a plain loop over the flat arrays, so that the compiler can vectorize it.
+static void appendTransformedPoints(std::vector<float> &dst, const std::vector<float> &src,
+                                    const QMatrix4x4 &m)
+{
+    const size_t offset = dst.size();
+    dst.resize(offset + src.size());
+
+    const float *md = m.constData(); // column-major
+    const float m00 = md[0], m10 = md[1], m20 = md[2];
+    const float m01 = md[4], m11 = md[5], m21 = md[6];
+    const float m02 = md[8], m12 = md[9], m22 = md[10];
+    const float m03 = md[12], m13 = md[13], m23 = md[14];
+
+    const float *s = src.data();
+    float *d = dst.data() + offset;
+
+    for (size_t i = 0; i < src.size(); i += 3) {
+        const float x = s[i], y = s[i + 1], z = s[i + 2];
+        d[i]     = m00 * x + m01 * y + m02 * z + m03;
+        d[i + 1] = m10 * x + m11 * y + m12 * z + m13;
+        d[i + 2] = m20 * x + m21 * y + m22 * z + m23;
+    }
+}
+
+static void appendPoints(std::vector<float> &dst, std::initializer_list<QVector3D> points)
+{
+    for (const auto &p : points) {
+        dst.push_back(p.x());
+        dst.push_back(p.y());
+        dst.push_back(p.z());
+    }
+}
+
 
 RenderController::RenderController(QObject *parent)
     : QObject(parent)
@@ -45,6 +103,16 @@ RenderController::RenderController(QObject *parent)
     m_lineGeo->setStride(3 * sizeof(float));
     m_lineGeo->addAttribute(QQuick3DGeometry::Attribute::PositionSemantic, 0, QQuick3DGeometry::Attribute::F32Type);
     m_lineGeo->setVertexData(QByteArray::fromRawData(reinterpret_cast<const char *>(lineGeo), sizeof(lineGeo)));
+
+    m_renderDataCache.setMaxCost(MaxRenderDataCacheCost);
+
+    // the cache references parts and colors
+    if (auto *lib = LDraw::library()) {
+        connect(lib, &Library::libraryAboutToBeReset,
+                this, [this]() { m_renderDataCache.clear(); });
+    }
+    connect(BrickLink::core()->database(), &BrickLink::Database::databaseAboutToBeReset,
+            this, [this]() { m_renderDataCache.clear(); });
 }
 
 RenderController::~RenderController()
@@ -159,8 +227,17 @@ void RenderController::setItemAndColor(const BrickLink::Item *item, const BrickL
 
             emit canRenderChanged(canRender());
 
+            if (auto *cached = m_renderDataCache.object({ part, color })) {
+                part->release();
+                if (color == m_color)
+                    applyRenderData(cached->m_data);
+                return;
+            }
+
             QtConcurrent::run(&RenderController::calculateRenderData, this, part, color)
                 .then(this, [this, color, part](RenderData data) {
+                    m_renderDataCache.insert({ part, color }, new CachedRenderData(part, data),
+                                             data.cost());
                     part->release();
                     if (part != m_part)
                         return;
@@ -189,94 +266,220 @@ RenderController::RenderData RenderController::calculateRenderData(Part *part, c
         return { };
     part->addRef();
 
-    QByteArray lineBuffer;
-    QList<QmlRenderGeometry *> geos;
-    QVector3D center;
-    float radius = 0;
+    RenderData data;
     QHash<const BrickLink::Color *, QByteArray> surfaceBuffers;
 
-    fillVertexBuffers(part, color, color, QMatrix4x4(), false, surfaceBuffers, lineBuffer);
+    const auto instancedParts = findInstancedParts(part);
+    FlatPartCache flatCache;
+    const FlatPart &flat = flattenPart(part, false, flatCache, instancedParts);
 
-    for (auto it = surfaceBuffers.cbegin(); it != surfaceBuffers.cend(); ++it) {
-        const QByteArray &data = it.value();
-        if (data.isEmpty())
-            continue;
-
-        const BrickLink::Color *surfaceColor = it.key();
-        const bool isTextured = surfaceColor->hasParticles() || (surfaceColor->id() == 0);
-
-        const int stride = (3 + 3 + (isTextured ? 2 : 0)) * sizeof(float);
-
-        auto geo = new QmlRenderGeometry(surfaceColor);
+    for (auto it = flat.triangles.cbegin(); it != flat.triangles.cend(); ++it) {
+        const BrickLink::Color *surfaceColor = it.key() ? it.key() : color;
+        addSurfaceToBuffer(surfaceBuffers[surfaceColor], surfaceColor, it.value());
+    }
 
-        // calculate bounding box
-        static constexpr auto fmin = std::numeric_limits<float>::min();
-        static constexpr auto fmax = std::numeric_limits<float>::max();
+    // group the instances by sub-part and color: each group is drawn with a single instanced model
+    std::map<std::tuple<const Part *, bool, const BrickLink::Color *>, std::vector<QMatrix4x4>> instanceGroups;
 
-        QVector3D vmin = QVector3D(fmax, fmax, fmax);
-        QVector3D vmax = QVector3D(fmin, fmin, fmin);
+    for (const auto &instance : flat.instances) {
+        const BrickLink::Color *instanceColor = instance.color ? instance.color : color;
 
-        for (int i = 0; i < data.size(); i += stride) {
-            auto v = reinterpret_cast<const float *>(it->constData() + i);
-            vmin = QVector3D(std::min(vmin.x(), v[0]), std::min(vmin.y(), v[1]), std::min(vmin.z(), v[2]));
-            vmax = QVector3D(std::max(vmax.x(), v[0]), std::max(vmax.y(), v[1]), std::max(vmax.z(), v[2]));
+        if (instance.matrix.determinant() < 0) {
+            // the normals of mirrored instances would be flipped on the GPU
+            const FlatPart &sub = flatCache.at({ instance.part, instance.inverted });
+            for (auto it = sub.triangles.cbegin(); it != sub.triangles.cend(); ++it) {
+                const BrickLink::Color *surfaceColor = it.key() ? it.key() : instanceColor;
+                std::vector<float> triangles;
+                appendTransformedPoints(triangles, it.value(), instance.matrix);
+                addSurfaceToBuffer(surfaceBuffers[surfaceColor], surfaceColor, triangles);
+            }
+        } else {
+            instanceGroups[{ instance.part, instance.inverted, instanceColor }].push_back(instance.matrix);
         }
+    }
 
-        // calculate bounding sphere
-        QVector3D surfaceCenter = (vmin + vmax) / 2;
-        float surfaceRadius = 0;
+    for (auto it = surfaceBuffers.cbegin(); it != surfaceBuffers.cend(); ++it) {
+        if (!it->isEmpty())
+            data.surfaces.append(surfaceFromBuffer(it.key(), it.value()));
+    }
 
-        for (int i = 0; i < data.size(); i += stride) {
-            auto v = reinterpret_cast<const float *>(it->constData() + i);
-            surfaceRadius = std::max(surfaceRadius, (surfaceCenter - QVector3D { v[0], v[1], v[2] }).lengthSquared());
-        }
-        surfaceRadius = std::sqrt(surfaceRadius);
-
-        geo->setPrimitiveType(QQuick3DGeometry::PrimitiveType::Triangles);
-        geo->setStride(stride);
-        geo->addAttribute(QQuick3DGeometry::Attribute::PositionSemantic, 0, QQuick3DGeometry::Attribute::F32Type);
-        geo->addAttribute(QQuick3DGeometry::Attribute::NormalSemantic, 3 * sizeof(float), QQuick3DGeometry::Attribute::F32Type);
-        if (isTextured) {
-            geo->addAttribute(QQuick3DGeometry::Attribute::TexCoord0Semantic, 6 * sizeof(float), QQuick3DGeometry::Attribute::F32Type);
-
-            QQuick3DTextureData *texData = generateMaterialTextureData(surfaceColor);
-            texData->setParentItem(geo);  // 3D scene parent
-            texData->setParent(geo);      // owning parent
-            geo->setTextureData(texData);
-        }
-        geo->setBounds(vmin, vmax);
-        geo->setCenter(surfaceCenter);
-        geo->setRadius(surfaceRadius);
-        geo->setVertexData(data);
+    for (const auto &[key, matrices] : instanceGroups) {
+        const auto &[subPart, inverted, instanceColor] = key;
+        const FlatPart &sub = flatCache.at({ subPart, inverted });
+
+        QByteArray instanceData;
+        instanceData.reserve(qsizetype(matrices.size() * sizeof(QQuick3DInstancing::InstanceTableEntry)));
+        for (const auto &matrix : matrices)
+            QmlRenderInstancing::addTransformToBuffer(instanceData, matrix);
+
+        for (auto it = sub.triangles.cbegin(); it != sub.triangles.cend(); ++it) {
+            const BrickLink::Color *surfaceColor = it.key() ? it.key() : instanceColor;
+            QByteArray vertexData;
+            addSurfaceToBuffer(vertexData, surfaceColor, it.value());
+            if (vertexData.isEmpty())
+                continue;
+
+            // the bounds are calculated in the sub-part's coordinate system...
+            RenderSurface surface = surfaceFromBuffer(surfaceColor, vertexData);
+
+            // ... and then transformed for every instance
+            static constexpr auto fmin = std::numeric_limits<float>::min();
+            static constexpr auto fmax = std::numeric_limits<float>::max();
+
+            QVector3D vmin = QVector3D(fmax, fmax, fmax);
+            QVector3D vmax = QVector3D(fmin, fmin, fmin);
+
+            for (const auto &matrix : matrices) {
+                for (int corner = 0; corner < 8; ++corner) {
+                    const auto v = matrix.map(QVector3D((corner & 1) ? surface.vmax.x() : surface.vmin.x(),
+                                                        (corner & 2) ? surface.vmax.y() : surface.vmin.y(),
+                                                        (corner & 4) ? surface.vmax.z() : surface.vmin.z()));
+                    vmin = QVector3D(std::min(vmin.x(), v.x()), std::min(vmin.y(), v.y()), std::min(vmin.z(), v.z()));
+                    vmax = QVector3D(std::max(vmax.x(), v.x()), std::max(vmax.y(), v.y()), std::max(vmax.z(), v.z()));
+                }
+            }
+            const QVector3D surfaceCenter = (vmin + vmax) / 2;
+            float surfaceRadius = 0;
+
+            for (const auto &matrix : matrices) {
+                const float scale = std::max({ matrix.column(0).toVector3D().length(),
+                                               matrix.column(1).toVector3D().length(),
+                                               matrix.column(2).toVector3D().length() });
+                const float d = (matrix.map(surface.center) - surfaceCenter).length();
+                surfaceRadius = std::max(surfaceRadius, d + surface.radius * scale);
+            }
 
-        geos.append(geo);
+            surface.vmin = vmin;
+            surface.vmax = vmax;
+            surface.center = surfaceCenter;
+            surface.radius = surfaceRadius;
+            surface.instanceData = instanceData;
+            data.surfaces.append(surface);
+        }
     }
 
-    for (auto *geo : std::as_const(geos)) {
+    for (const auto &surface : std::as_const(data.surfaces)) {
         // Merge all the bounding spheres. This is not perfect, but very, very close in most cases
-        const auto geoCenter = geo->center();
-        const auto geoRadius = geo->radius();
+        const auto geoCenter = surface.center;
+        const auto geoRadius = surface.radius;
 
-        if (qFuzzyIsNull(radius)) { // first one
-            center = geoCenter;
-            radius = geoRadius;
+        if (qFuzzyIsNull(data.radius)) { // first one
+            data.center = geoCenter;
+            data.radius = geoRadius;
         } else {
-            QVector3D d = geoCenter - center;
+            QVector3D d = geoCenter - data.center;
             float l = d.length();
 
-            if ((l + radius) < geoRadius) { // the old one is inside the new one
-                center = geoCenter;
-                radius = geoRadius;
-            } else if ((l + geoRadius) > radius) { // the new one is NOT inside the old one -> we need to merge
-                float nr = (radius + l + geoRadius) / 2;
-                center = center + (geoCenter - center).normalized() * (nr - radius);
-                radius = nr;
+            if ((l + data.radius) < geoRadius) { // the old one is inside the new one
+                data.center = geoCenter;
+                data.radius = geoRadius;
+            } else if ((l + geoRadius) > data.radius) { // the new one is NOT inside the old one -> we need to merge
+                float nr = (data.radius + l + geoRadius) / 2;
+                data.center = data.center + (geoCenter - data.center).normalized() * (nr - data.radius);
+                data.radius = nr;
             }
         }
     }
 
+    auto lineQColor = [color](const FlatPart::LineColor &lc) -> QColor {
+        if (lc.isEdge) {
+            if (auto c = lc.color ? lc.color : color)
+                return c->ldrawEdgeColor();
+        } else if (lc.color) {
+            return lc.color->ldrawColor();
+        }
+        return Qt::black;
+    };
+
+    data.lineBuffer.reserve(qsizetype((flat.lineColors.size() + flat.condLineColors.size())
+                                      * sizeof(QQuick3DInstancing::InstanceTableEntry)));
+
+    for (size_t i = 0; i < flat.lineColors.size(); ++i) {
+        const float *v = flat.lines.data() + i * 6;
+        QmlRenderLineInstancing::addLineToBuffer(data.lineBuffer, lineQColor(flat.lineColors[i]),
+                                                 { v[0], v[1], v[2] }, { v[3], v[4], v[5] });
+    }
+    for (size_t i = 0; i < flat.condLineColors.size(); ++i) {
+        const float *v = flat.condLines.data() + i * 12;
+        QmlRenderLineInstancing::addConditionalLineToBuffer(data.lineBuffer, lineQColor(flat.condLineColors[i]),
+                                                            { v[0], v[1], v[2] }, { v[3], v[4], v[5] },
+                                                            { v[6], v[7], v[8] }, { v[9], v[10], v[11] });
+    }
+
     part->release();
-    return { lineBuffer, geos, center, radius };
+    return data;
+}
+
+RenderController::RenderSurface RenderController::surfaceFromBuffer(const BrickLink::Color *color,
+                                                                    const QByteArray &data)
+{
+    const bool isTextured = color->hasParticles() || (color->id() == 0);
+    const int stride = (3 + 3 + (isTextured ? 2 : 0)) * sizeof(float);
+
+    // calculate bounding box
+    static constexpr auto fmin = std::numeric_limits<float>::min();
+    static constexpr auto fmax = std::numeric_limits<float>::max();
+
+    QVector3D vmin = QVector3D(fmax, fmax, fmax);
+    QVector3D vmax = QVector3D(fmin, fmin, fmin);
+
+    for (int i = 0; i < data.size(); i += stride) {
+        auto v = reinterpret_cast<const float *>(data.constData() + i);
+        vmin = QVector3D(std::min(vmin.x(), v[0]), std::min(vmin.y(), v[1]), std::min(vmin.z(), v[2]));
+        vmax = QVector3D(std::max(vmax.x(), v[0]), std::max(vmax.y(), v[1]), std::max(vmax.z(), v[2]));
+    }
+
+    // calculate bounding sphere
+    QVector3D surfaceCenter = (vmin + vmax) / 2;
+    float surfaceRadius = 0;
+
+    for (int i = 0; i < data.size(); i += stride) {
+        auto v = reinterpret_cast<const float *>(data.constData() + i);
+        surfaceRadius = std::max(surfaceRadius, (surfaceCenter - QVector3D { v[0], v[1], v[2] }).lengthSquared());
+    }
+    surfaceRadius = std::sqrt(surfaceRadius);
+
+    RenderSurface surface;
+    surface.color = color;
+    surface.vertexData = data;
+    surface.vmin = vmin;
+    surface.vmax = vmax;
+    surface.center = surfaceCenter;
+    surface.radius = surfaceRadius;
+    return surface;
+}
+
+QmlRenderGeometry *RenderController::createGeometry(const RenderSurface &surface)
+{
+    const bool isTextured = surface.color->hasParticles() || (surface.color->id() == 0);
+    const int stride = (3 + 3 + (isTextured ? 2 : 0)) * sizeof(float);
+
+    auto geo = new QmlRenderGeometry(surface.color);
+
+    geo->setPrimitiveType(QQuick3DGeometry::PrimitiveType::Triangles);
+    geo->setStride(stride);
+    geo->addAttribute(QQuick3DGeometry::Attribute::PositionSemantic, 0, QQuick3DGeometry::Attribute::F32Type);
+    geo->addAttribute(QQuick3DGeometry::Attribute::NormalSemantic, 3 * sizeof(float), QQuick3DGeometry::Attribute::F32Type);
+    if (isTextured) {
+        geo->addAttribute(QQuick3DGeometry::Attribute::TexCoord0Semantic, 6 * sizeof(float), QQuick3DGeometry::Attribute::F32Type);
+
+        QQuick3DTextureData *texData = generateMaterialTextureData(surface.color);
+        texData->setParentItem(geo);  // 3D scene parent
+        texData->setParent(geo);      // owning parent
+        geo->setTextureData(texData);
+    }
+    if (!surface.instanceData.isEmpty()) {
+        auto instancing = new QmlRenderInstancing();
+        instancing->setBuffer(surface.instanceData);
+        instancing->setParentItem(geo);  // 3D scene parent
+        instancing->setParent(geo);      // owning parent
+        geo->setInstancing(instancing);
+    }
+    geo->setBounds(surface.vmin, surface.vmax);
+    geo->setCenter(surface.center);
+    geo->setRadius(surface.radius);
+    geo->setVertexData(surface.vertexData);
+    return geo;
 }
 
 void RenderController::applyRenderData(const RenderData &data)
@@ -286,7 +489,10 @@ void RenderController::applyRenderData(const RenderData &data)
         m_lines->setBuffer(data.lineBuffer);
     m_lines->update();
     qDeleteAll(m_geos);
-    m_geos = data.geos;
+    m_geos.clear();
+    m_geos.reserve(data.surfaces.size());
+    for (const auto &surface : data.surfaces)
+        m_geos.append(createGeometry(surface));
 
     emit surfacesChanged();
 
@@ -301,8 +507,69 @@ void RenderController::applyRenderData(const RenderData &data)
     emit itemOrColorChanged();
 }
 
-std::vector<std::pair<float, float>> RenderController::uvMapToNearestPlane(const QVector3D &normal,
-                                                                           std::initializer_list<const QVector3D> vectors)
+int RenderController::RenderData::cost() const
+{
+    qsizetype bytes = lineBuffer.size();
+    for (const auto &surface : surfaces)
+        bytes += surface.vertexData.size() + surface.instanceData.size();
+    return int(bytes / 1024) + 1;
+}
+
+RenderController::CachedRenderData::CachedRenderData(Part *part, const RenderData &data)
+    : m_part(part)
+    , m_data(data)
+{
+    m_part->addRef();
+}
+
+RenderController::CachedRenderData::~CachedRenderData()
+{
+    m_part->release();
+}
+
+static void countPartUses(const Part *part, QHash<const Part *, int> &useCount)
+{
+    for (const Element *e : part->elements()) {
+        if (e->type() == Element::Type::Part) {
+            if (const Part *sub = static_cast<const PartElement *>(e)->part()) {
+                ++useCount[sub];
+                countPartUses(sub, useCount);
+            }
+        }
+    }
+}
+
+static void collectInstancedParts(const Part *part, const QHash<const Part *, int> &useCount,
+                                  QSet<const Part *> &visited, QSet<const Part *> &instanced)
+{
+    for (const Element *e : part->elements()) {
+        if (e->type() == Element::Type::Part) {
+            const Part *sub = static_cast<const PartElement *>(e)->part();
+            if (!sub || visited.contains(sub))
+                continue;
+            visited.insert(sub);
+
+            // only the outermost sub-part is instanced: a stud, but not the cylinder inside it
+            if (useCount.value(sub) >= MinInstanceCount)
+                instanced.insert(sub);
+            else
+                collectInstancedParts(sub, useCount, visited, instanced);
+        }
+    }
+}
+
+QSet<const Part *> RenderController::findInstancedParts(const Part *part)
+{
+    QHash<const Part *, int> useCount;
+    countPartUses(part, useCount);
+
+    QSet<const Part *> visited;
+    QSet<const Part *> instanced;
+    collectInstancedParts(part, useCount, visited, instanced);
+    return instanced;
+}
+
+std::pair<int, int> RenderController::uvAxesOfNearestPlane(const QVector3D &normal)
 {
     const float ax = std::abs(normal.x());
     const float ay = std::abs(normal.y());
@@ -323,59 +590,40 @@ std::vector<std::pair<float, float>> RenderController::uvMapToNearestPlane(const
         if (normal.z() < 0)
             std::swap(uc, vc);
     }
-
-    std::vector<std::pair<float, float>> uv;
-    for (auto &&vec : std::as_const(vectors))
-        uv.emplace_back(vec[uc] / 24, vec[vc] / 24);
-
-    return uv;
+    return { uc, vc };
 }
 
-void RenderController::fillVertexBuffers(Part *part, const BrickLink::Color *modelColor,
-                                         const BrickLink::Color *baseColor,const QMatrix4x4 &matrix,
-                                         bool inverted, QHash<const BrickLink::Color *, QByteArray> &surfaceBuffers,
-                                         QByteArray &lineBuffer)
+const RenderController::FlatPart &RenderController::flattenPart(const Part *part, bool inverted,
+                                                                FlatPartCache &cache,
+                                                                const QSet<const Part *> &instancedParts)
 {
-    if (!part)
-        return;
+    const auto key = std::make_pair(part, inverted);
+    if (auto it = cache.find(key); it != cache.end())
+        return it->second;
+
+    // std::map never invalidates references, so the recursion below is safe
+    FlatPart &flat = cache[key];
 
     bool invertNext = false;
     bool ccw = true;
 
-    static auto addFloatsToByteArray = [](QByteArray &buffer, std::initializer_list<float> fs) {
-        qsizetype oldSize = buffer.size();
-        size_t size = fs.size() * sizeof(float);
-        buffer.resize(oldSize + qsizetype(size));
-        auto *ptr = reinterpret_cast<float *>(buffer.data() + oldSize);
-        memcpy(ptr, fs.begin(), size);
-    };
+    // consecutive elements very often share the same color
+    const BrickLink::Color *lastColor = nullptr;
+    std::vector<float> *lastTriangles = nullptr;
 
-    auto mapColor = [&baseColor, &modelColor](int colorId) -> const BrickLink::Color * {
-        auto c = (colorId == 16) ? (baseColor ? baseColor : modelColor)
-                                 : BrickLink::core()->colorFromLDrawId(colorId);
-        if (!c && colorId >= 256) {
-            int newColorId = ((colorId - 256) & 0x0f);
-            qCWarning(LogLDraw) << "Dithered colors are not supported, using only one:"
-                                << colorId << "->" << newColorId;
-            c = BrickLink::core()->colorFromLDrawId(newColorId);
-        }
-        if (!c) {
-            qCWarning(LogLDraw) << "Could not map LDraw color" << colorId;
-            c = BrickLink::core()->color(9 /*light gray*/);
+    auto trianglesFor = [&](int colorId) -> std::vector<float> & {
+        auto c = (colorId == 16) ? nullptr : mapColor(colorId);
+        if (!lastTriangles || (c != lastColor)) {
+            lastColor = c;
+            lastTriangles = &flat.triangles[c];
         }
-        return c;
+        return *lastTriangles;
     };
 
-    auto mapEdgeQColor = [&baseColor, &modelColor](int colorId) -> QColor {
-        if (colorId == 24) {
-            if (baseColor)
-                return baseColor->ldrawEdgeColor();
-            else if (modelColor)
-                return modelColor->ldrawEdgeColor();
-        } else if (auto *c = BrickLink::core()->colorFromLDrawId(colorId)) {
-            return c->ldrawColor();
-        }
-        return Qt::black;
+    auto lineColor = [](int colorId) -> FlatPart::LineColor {
+        if (colorId == 24)
+            return { nullptr, true };
+        return { BrickLink::core()->colorFromLDrawId(colorId), false };
     };
 
     const auto &elements = part->elements();
@@ -401,85 +649,46 @@ void RenderController::fillVertexBuffers(Part *part, const BrickLink::Color *mod
         }
         case Element::Type::Triangle: {
             const auto te = static_cast<const TriangleElement *>(e);
-            const auto color = mapColor(te->color());
             const auto p = te->points();
-            const auto p0m = matrix.map(p[0]);
-            const auto p1m = matrix.map(ccw ? p[2] : p[1]);
-            const auto p2m = matrix.map(ccw ? p[1] : p[2]);
-            const auto n = QVector3D::normal(p0m, p1m, p2m);
-
-            if (color->hasParticles() || (color->id() == 0)) {
-                const auto uv = uvMapToNearestPlane(n, { p0m, p1m, p2m });
-
-                addFloatsToByteArray(surfaceBuffers[color], {
-                    p0m.x(), p0m.y(), p0m.z(), n.x(), n.y(), n.z(), uv[0].first, uv[0].second,
-                    p1m.x(), p1m.y(), p1m.z(), n.x(), n.y(), n.z(), uv[1].first, uv[1].second,
-                    p2m.x(), p2m.y(), p2m.z(), n.x(), n.y(), n.z(), uv[2].first, uv[2].second });
-            } else {
-                addFloatsToByteArray(surfaceBuffers[color], {
-                    p0m.x(), p0m.y(), p0m.z(), n.x(), n.y(), n.z(),
-                    p1m.x(), p1m.y(), p1m.z(), n.x(), n.y(), n.z(),
-                    p2m.x(), p2m.y(), p2m.z(), n.x(), n.y(), n.z() });
-            }
+            appendPoints(trianglesFor(te->color()), { p[0], p[ccw ? 2 : 1], p[ccw ? 1 : 2] });
             break;
         }
         case Element::Type::Quad: {
             const auto qe = static_cast<const QuadElement *>(e);
-            const auto color = mapColor(qe->color());
             const auto p = qe->points();
-            const auto p0m = matrix.map(p[0]);
-            const auto p1m = matrix.map(p[ccw ? 3 : 1]);
-            const auto p2m = matrix.map(p[2]);
-            const auto p3m = matrix.map(p[ccw ? 1 : 3]);
-            const auto n = QVector3D::normal(p0m, p1m, p2m);
-
-            if (color->hasParticles() || (color->id() == 0)) {
-                const auto uv = uvMapToNearestPlane(n, { p0m, p1m, p2m, p3m });
-
-                addFloatsToByteArray(surfaceBuffers[color], {
-                    p0m.x(), p0m.y(), p0m.z(), n.x(), n.y(), n.z(), uv[0].first, uv[0].second,
-                    p1m.x(), p1m.y(), p1m.z(), n.x(), n.y(), n.z(), uv[1].first, uv[1].second,
-                    p2m.x(), p2m.y(), p2m.z(), n.x(), n.y(), n.z(), uv[2].first, uv[2].second,
-                    p2m.x(), p2m.y(), p2m.z(), n.x(), n.y(), n.z(), uv[2].first, uv[2].second,
-                    p3m.x(), p3m.y(), p3m.z(), n.x(), n.y(), n.z(), uv[3].first, uv[3].second,
-                    p0m.x(), p0m.y(), p0m.z(), n.x(), n.y(), n.z(), uv[0].first, uv[0].second });
-            } else {
-                addFloatsToByteArray(surfaceBuffers[color], {
-                    p0m.x(), p0m.y(), p0m.z(), n.x(), n.y(), n.z(),
-                    p1m.x(), p1m.y(), p1m.z(), n.x(), n.y(), n.z(),
-                    p2m.x(), p2m.y(), p2m.z(), n.x(), n.y(), n.z(),
-                    p2m.x(), p2m.y(), p2m.z(), n.x(), n.y(), n.z(),
-                    p3m.x(), p3m.y(), p3m.z(), n.x(), n.y(), n.z(),
-                    p0m.x(), p0m.y(), p0m.z(), n.x(), n.y(), n.z() });
-            }
+            const auto &p1 = p[ccw ? 3 : 1];
+            const auto &p3 = p[ccw ? 1 : 3];
+            appendPoints(trianglesFor(qe->color()), { p[0], p1, p[2], p[2], p3, p[0] });
             break;
         }
         case Element::Type::Line: {
             const auto le = static_cast<const LineElement *>(e);
-            const auto c = mapEdgeQColor(le->color());
             const auto p = le->points();
-            auto p0m = matrix.map(p[0]);
-            auto p1m = matrix.map(p[1]);
-            QmlRenderLineInstancing::addLineToBuffer(lineBuffer, c, p0m, p1m);
+            appendPoints(flat.lines, { p[0], p[1] });
+            flat.lineColors.push_back(lineColor(le->color()));
             break;
         }
         case Element::Type::CondLine: {
             const auto cle = static_cast<const CondLineElement *>(e);
-            const auto c = mapEdgeQColor(cle->color());
             const auto p = cle->points();
-            auto p0m = matrix.map(p[0]);
-            auto p1m = matrix.map(p[1]);
-            auto p2m = matrix.map(p[2]);
-            auto p3m = matrix.map(p[3]);
-            QmlRenderLineInstancing::addConditionalLineToBuffer(lineBuffer, c, p0m, p1m, p2m, p3m);
+            appendPoints(flat.condLines, { p[0], p[1], p[2], p[3] });
+            flat.condLineColors.push_back(lineColor(cle->color()));
             break;
         }
         case Element::Type::Part: {
             const auto pe = static_cast<const PartElement *>(e);
+            if (!pe->part())
+                break;
             bool matrixReversed = (pe->matrix().determinant() < 0);
-
-            fillVertexBuffers(pe->part(), modelColor, mapColor(pe->color()), matrix * pe->matrix(),
-                              inverted ^ invertNext ^ matrixReversed, surfaceBuffers, lineBuffer);
+            const bool subInverted = inverted ^ invertNext ^ matrixReversed;
+            const auto subColor = (pe->color() == 16) ? nullptr : mapColor(pe->color());
+            const bool asInstance = instancedParts.contains(pe->part());
+
+            const FlatPart &sub = flattenPart(pe->part(), subInverted, cache, instancedParts);
+            if (asInstance)
+                flat.instances.push_back({ pe->part(), subInverted, subColor, pe->matrix() });
+            addFlatPart(flat, sub, pe->matrix(), subColor, !asInstance);
+            lastTriangles = nullptr; // addFlatPart may have rehashed flat.triangles
             break;
         }
         default:
@@ -489,6 +698,67 @@ void RenderController::fillVertexBuffers(Part *part, const BrickLink::Color *mod
         if (!isBFCCommand || !isBFCInvertNext)
             invertNext = false;
     }
+    return flat;
+}
+
+void RenderController::addFlatPart(FlatPart &flat, const FlatPart &sub, const QMatrix4x4 &matrix,
+                                   const BrickLink::Color *subColor, bool withTriangles)
+{
+    if (withTriangles) {
+        for (auto it = sub.triangles.cbegin(); it != sub.triangles.cend(); ++it)
+            appendTransformedPoints(flat.triangles[it.key() ? it.key() : subColor], it.value(), matrix);
+    }
+
+    auto inherit = [subColor](FlatPart::LineColor lc) {
+        if (!lc.color && lc.isEdge)
+            lc.color = subColor;
+        return lc;
+    };
+
+    appendTransformedPoints(flat.lines, sub.lines, matrix);
+    flat.lineColors.reserve(flat.lineColors.size() + sub.lineColors.size());
+    for (const auto &lc : sub.lineColors)
+        flat.lineColors.push_back(inherit(lc));
+
+    appendTransformedPoints(flat.condLines, sub.condLines, matrix);
+    flat.condLineColors.reserve(flat.condLineColors.size() + sub.condLineColors.size());
+    for (const auto &lc : sub.condLineColors)
+        flat.condLineColors.push_back(inherit(lc));
+
+    // the lines of instanced sub-parts are always merged: they are instanced already
+    flat.instances.reserve(flat.instances.size() + sub.instances.size());
+    for (const auto &instance : sub.instances) {
+        flat.instances.push_back({ instance.part, instance.inverted,
+                                   instance.color ? instance.color : subColor,
+                                   matrix * instance.matrix });
+    }
+}
+
+void RenderController::addSurfaceToBuffer(QByteArray &buffer, const BrickLink::Color *color,
+                                          const std::vector<float> &triangles)
+{
+    const bool isTextured = color->hasParticles() || (color->id() == 0);
+    const size_t floatsPerVertex = isTextured ? 8 : 6;
+
+    const qsizetype offset = buffer.size();
+    buffer.resize(offset + qsizetype(triangles.size() / 3 * floatsPerVertex * sizeof(float)));
+    float *d = reinterpret_cast<float *>(buffer.data() + offset);
+
+    for (size_t i = 0; i + 9 <= triangles.size(); i += 9) {
+        const float *t = triangles.data() + i;
+        const QVector3D p[3] = { { t[0], t[1], t[2] }, { t[3], t[4], t[5] }, { t[6], t[7], t[8] } };
+        const auto n = QVector3D::normal(p[0], p[1], p[2]);
+        const auto [uc, vc] = isTextured ? uvAxesOfNearestPlane(n) : std::pair { 0, 0 };
+
+        for (const auto &v : p) {
+            *d++ = v.x(); *d++ = v.y(); *d++ = v.z();
+            *d++ = n.x(); *d++ = n.y(); *d++ = n.z();
+            if (isTextured) {
+                *d++ = v[uc] / 24;
+                *d++ = v[vc] / 24;
+            }
+        }
+    }
 }
 
 QQuick3DTextureData *RenderController::generateMaterialTextureData(const BrickLink::Color *color)
@@ -3,7 +3,13 @@
 
 #pragma once
 
+#include <map>
+#include <tuple>
+#include <vector>
+
 #include <QtCore/QObject>
+#include <QtCore/QCache>
+#include <QtCore/QSet>
 #include <QtGui/QColor>
 #include <QtGui/QQuaternion>
 #include <QtQml/qqmlregistration.h>
@@ -84,23 +90,74 @@ signals:
     void clearColorChanged(const QColor &clearColor);
 
 private:
+    struct RenderSurface {
+        const BrickLink::Color *color = nullptr;
+        QByteArray vertexData;
+        QByteArray instanceData; // only set for instanced sub-parts
+        QVector3D vmin;
+        QVector3D vmax;
+        QVector3D center;
+        float radius = 0;
+    };
+
+    // plain data only, so that it can be calculated in a thread and cached
     struct RenderData {
         QByteArray lineBuffer;
-        QList<QmlRenderGeometry *> geos;
+        QVector<RenderSurface> surfaces;
         QVector3D center;
         float radius = 0;
+
+        int cost() const; // in KB
+    };
+
+    struct CachedRenderData {
+        CachedRenderData(Part *part, const RenderData &data);
+        ~CachedRenderData();
+        Q_DISABLE_COPY_MOVE(CachedRenderData)
+
+        Part *m_part;
+        RenderData m_data;
     };
 
     RenderData calculateRenderData(Part *part, const BrickLink::Color *color);
     void applyRenderData(const RenderData &data);
-
-    static void fillVertexBuffers(Part *part, const BrickLink::Color *modelColor,
-                                  const BrickLink::Color *baseColor, const QMatrix4x4 &matrix,
-                                  bool inverted, QHash<const BrickLink::Color *, QByteArray> &surfaceBuffers,
-                                  QByteArray &lineBuffer);
+    static QmlRenderGeometry *createGeometry(const RenderSurface &surface);
+
+    // A part with all its sub-parts resolved and transformed into its own coordinate system.
+    // The color nullptr stands for the color inherited from the parent (LDraw colors 16 and 24)
+    struct FlatPart {
+        struct LineColor {
+            const BrickLink::Color *color;
+            bool isEdge;
+        };
+        // the triangles of frequently used sub-parts are not merged, but drawn instanced
+        struct Instance {
+            const Part *part;
+            bool inverted;
+            const BrickLink::Color *color;
+            QMatrix4x4 matrix;
+        };
+
+        QHash<const BrickLink::Color *, std::vector<float>> triangles; // 3 x xyz, wound CCW
+        std::vector<float> lines;       // 2 x xyz
+        std::vector<LineColor> lineColors;
+        std::vector<float> condLines;   // 4 x xyz
+        std::vector<LineColor> condLineColors;
+        std::vector<Instance> instances;
+    };
+    // key: part and BFC inversion
+    using FlatPartCache = std::map<std::pair<const Part *, bool>, FlatPart>;
+
+    static QSet<const Part *> findInstancedParts(const Part *part);
+    static const FlatPart &flattenPart(const Part *part, bool inverted, FlatPartCache &cache,
+                                       const QSet<const Part *> &instancedParts);
+    static void addFlatPart(FlatPart &flat, const FlatPart &sub, const QMatrix4x4 &matrix,
+                            const BrickLink::Color *subColor, bool withTriangles);
+    static RenderSurface surfaceFromBuffer(const BrickLink::Color *color, const QByteArray &data);
+    static void addSurfaceToBuffer(QByteArray &buffer, const BrickLink::Color *color,
+                                   const std::vector<float> &triangles);
     static QQuick3DTextureData *generateMaterialTextureData(const BrickLink::Color *color);
-    static std::vector<std::pair<float, float> > uvMapToNearestPlane(const QVector3D &normal,
-                                                                     std::initializer_list<const QVector3D> vectors);
+    static std::pair<int, int> uvAxesOfNearestPlane(const QVector3D &normal);
 
     QList<QmlRenderGeometry *> m_geos;
     QQuick3DGeometry *m_lineGeo = nullptr;
@@ -108,6 +165,9 @@ private:
 
     static QHash<const BrickLink::Color *, QImage> s_materialTextureDatas;
 
+    // switching back and forth between items or colors should not recalculate everything
+    QCache<std::pair<const Part *, const BrickLink::Color *>, CachedRenderData> m_renderDataCache;
+
     Part *m_part = nullptr;
     const BrickLink::Item *m_item = nullptr;
     const BrickLink::Color *m_color = nullptr;
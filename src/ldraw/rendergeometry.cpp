@@ -13,29 +13,40 @@ QmlRenderGeometry::QmlRenderGeometry(const BrickLink::Color *color)
     , m_color(color)
 { }
 
-QmlRenderLineInstancing::QmlRenderLineInstancing()
+QmlRenderInstancing::QmlRenderInstancing()
 {
     markDirty();
 }
 
-QByteArray QmlRenderLineInstancing::getInstanceBuffer(int *instanceCount)
+QByteArray QmlRenderInstancing::getInstanceBuffer(int *instanceCount)
 {
     *instanceCount = int(m_buffer.size()) / int(sizeof(InstanceTableEntry));
     return m_buffer;
 }
 
-void QmlRenderLineInstancing::clear()
+void QmlRenderInstancing::clear()
 {
     m_buffer.clear();
     markDirty();
 }
 
-void QmlRenderLineInstancing::setBuffer(const QByteArray &ba)
+void QmlRenderInstancing::setBuffer(const QByteArray &ba)
 {
     m_buffer = ba;
     markDirty();
 }
 
+void QmlRenderInstancing::addTransformToBuffer(QByteArray &buffer, const QMatrix4x4 &matrix)
+{
+    // the color is multiplied with the material's base color
+    QQuick3DInstancing::InstanceTableEntry entry { matrix.row(0),
+                                                   matrix.row(1),
+                                                   matrix.row(2),
+                                                   QVector4D { 1, 1, 1, 1 },
+                                                   { } };
+    buffer.append(reinterpret_cast<const char *>(&entry), sizeof(entry));
+}
+
 
 //static QVector4D sRGBToLinear(const QColor &c)
 //{
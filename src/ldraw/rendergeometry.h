@@ -4,6 +4,7 @@
 #pragma once
 
 #include <QtGui/QColor>
+#include <QtGui/QMatrix4x4>
 #include <QtGui/QVector3D>
 #include <QQmlEngine>
 #include <QtQuick3D/QQuick3DGeometry>
@@ -29,6 +30,7 @@ class QmlRenderGeometry : public QQuick3DGeometry
     Q_PROPERTY(bool isMetallic READ isMetallic CONSTANT FINAL)
     Q_PROPERTY(bool isPearl READ isPearl CONSTANT FINAL)
     Q_PROPERTY(QQuick3DTextureData *textureData READ textureData CONSTANT FINAL)
+    Q_PROPERTY(QQuick3DInstancing *instancing READ instancing CONSTANT FINAL)
     Q_PROPERTY(QVector3D center READ center CONSTANT FINAL)
     Q_PROPERTY(float radius READ radius CONSTANT FINAL)
 
@@ -42,6 +44,8 @@ public:
     bool isPearl() const        { return m_color->isPearl(); }
     QQuick3DTextureData *textureData() const     { return m_texture; }
     void setTextureData(QQuick3DTextureData *td) { m_texture = td; }
+    QQuick3DInstancing *instancing() const       { return m_instancing; }
+    void setInstancing(QQuick3DInstancing *i)    { m_instancing = i; }
     QVector3D center() const                     { return m_center; }
     void setCenter(const QVector3D &center)      { m_center = center; }
     float radius() const                         { return m_radius; }
@@ -50,28 +54,37 @@ public:
 private:
     const BrickLink::Color *m_color;
     QQuick3DTextureData *m_texture = nullptr;
+    QQuick3DInstancing *m_instancing = nullptr;
     QVector3D m_center;
     float m_radius = 0;
 };
 
-class QmlRenderLineInstancing : public QQuick3DInstancing
+class QmlRenderInstancing : public QQuick3DInstancing
 {
     Q_OBJECT
 
 public:
-    QmlRenderLineInstancing();
+    QmlRenderInstancing();
     QByteArray getInstanceBuffer(int *instanceCount) override;
 
     void clear();
     void setBuffer(const QByteArray &ba);
 
+    static void addTransformToBuffer(QByteArray &buffer, const QMatrix4x4 &matrix);
+
+private:
+    QByteArray m_buffer;
+};
+
+class QmlRenderLineInstancing : public QmlRenderInstancing
+{
+    Q_OBJECT
+
+public:
     static void addLineToBuffer(QByteArray &buffer, const QColor &c, const QVector3D &p0,
                                 const QVector3D &p1);
     static void addConditionalLineToBuffer(QByteArray &buffer, const QColor &c, const QVector3D &p0,
                                            const QVector3D &p1, const QVector3D &p2, const QVector3D &p3);
-
-private:
-    QByteArray m_buffer;
 };
 
 } // namespace LDraw
@@ -162,6 +162,20 @@ void ChunkReader::endChunk()
         throw ChunkException(dataStream(), "end of chunk header does not match start of chunk header");
 }
 
+QVector<ChunkReader::ChunkInfo> ChunkReader::readChunkDirectory()
+{
+    checkChunkStarted();
+
+    QVector<ChunkInfo> directory;
+    while (startChunk()) {
+        const read_chunk_info &ci = std::as_const(m_chunks).top();
+        directory.append({ ci.id, ci.version, ci.startpos, ci.size });
+        skipChunk();
+        endChunk();
+    }
+    return directory;
+}
+
 quint32 ChunkReader::chunkId() const
 {
     if (m_chunks.isEmpty())
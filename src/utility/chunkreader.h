@@ -31,6 +31,15 @@ class ChunkReader {
 public:
     ChunkReader(QIODevice *dev, QDataStream::ByteOrder bo);
 
+    struct ChunkInfo {
+        quint32 id;
+        quint32 version;
+        qint64 startpos; // of the data, relative to the start of the device
+        qint64 size;
+
+        quint64 idAndVersion() const { return id | (quint64(version) << 32); }
+    };
+
     QDataStream &dataStream();
 
     // all 3 throw Exceptions on error
@@ -38,6 +47,10 @@ public:
     void endChunk();
     void skipChunk();
 
+    // scans the headers of all sub-chunks of the current chunk without reading their data.
+    // Afterwards the device is positioned at the end of the current chunk.
+    QVector<ChunkInfo> readChunkDirectory();
+
     quint32 chunkId() const;
     quint32 chunkVersion() const;
     quint64 chunkIdAndVersion() const;
@@ -133,6 +133,20 @@ public:
         return { *this, mr };
     }
 
+    // Raw access to the in-memory layout (size header followed by the elements). This is used
+    // to store arrays verbatim in a file and later point them straight into a memory mapping.
+    // An array attached via fromRawData() must never be resized.
+    inline const void *rawData() const { return data; }
+    inline qsizetype rawDataSize() const { return data ? qsizetype((size() + 1) * sizeof(T)) : 0LL; }
+    static constexpr size_t rawDataAlignment()
+    {
+        return std::max(alignof(T), alignof(typename QIntegerForSizeof<T>::Signed));
+    }
+    void fromRawData(const void *raw)
+    {
+        data = static_cast<T *>(const_cast<void *>(raw));
+    }
+
 private:
     const typename QIntegerForSizeof<T>::Signed &sizeRef(const T *t) const
     {
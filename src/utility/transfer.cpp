@@ -401,6 +401,10 @@ void TransferRetriever::downloadFinished(QNetworkReply *reply)
     j->m_respcode = j->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toUInt();
     j->m_effective_url = j->m_reply->url();
 
+    // local files, e.g. a stand-in for an update server, have no HTTP status
+    if (!j->m_respcode && (error == QNetworkReply::NoError) && j->m_url.isLocalFile())
+        j->m_respcode = 200;
+
     if (error != QNetworkReply::NoError) {
         m_sslSessionForHost.remove(j->m_url.host());
 